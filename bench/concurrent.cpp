@@ -0,0 +1,463 @@
+// throughput and round trip latency of the concurrent rings with pinned threads.
+//
+//   circular_buffer_concurrent_bench [--producer-cpu N] [--consumer-cpu N]
+//                                    [--count N] [--round-trips N] [--ring NAME]
+//   circular_buffer_concurrent_bench --check
+//
+// the cpus select the topology that is measured, e.g. two hyper threads of one core,
+// two cores of one socket or two sockets ( see lscpu -e ). NAME is spsc, spsc_batch,
+// mpmc, mpmc_batch, mutex or mutex_batch, all of them are run by default.
+// --check only runs small correctness workloads and exits with a failure if any of
+// them loses or reorders an element, which is what the tsan build runs as a test.
+
+#define JM_CIRCULAR_BUFFER_CXX14
+#include <circular_buffer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+    typedef std::chrono::steady_clock clock_type;
+
+    constexpr std::size_t capacity = 1024;
+
+    struct options {
+        int         producer_cpu = -1;
+        int         consumer_cpu = -1;
+        long long   count        = 10000000;
+        long long   round_trips  = 200000;
+        std::string ring;
+        bool        check = false;
+
+        // waiting threads spin, unless they would take the cpu from the thread they
+        // are waiting for
+        bool share_cpu = false;
+
+        void wait() const
+        {
+            if(share_cpu)
+                std::this_thread::yield();
+        }
+    };
+
+    void pin_to(int cpu)
+    {
+        if(cpu < 0)
+            return;
+
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            std::fprintf(stderr, "could not pin a thread to cpu %d\n", cpu);
+#else
+        std::fprintf(stderr, "pinning is only supported on linux, cpu %d ignored\n", cpu);
+#endif
+    }
+
+    // the rings behind the interface the workloads use
+    struct spsc_ring {
+        jm::spsc_circular_buffer<long long, capacity> ring;
+
+        bool try_push(long long value) { return ring.try_push(value); }
+        bool try_pop(long long& value) { return ring.try_pop(value); }
+
+        // batches are written and read in place
+        template<class F>
+        std::size_t push_batch(std::size_t count, F next)
+        {
+            const jm::ring_segments<long long> slots = ring.reserve(count);
+            for(std::size_t i = 0; i < slots.size(); ++i)
+                *slots[i] = next();
+            ring.commit(slots.size());
+            return slots.size();
+        }
+
+        template<class F>
+        std::size_t pop_batch(std::size_t count, F consume)
+        {
+            const jm::ring_segments<long long> items = ring.peek(count);
+            for(std::size_t i = 0; i < items.size(); ++i)
+                consume(*items[i]);
+            ring.release(items.size());
+            return items.size();
+        }
+    };
+
+    struct mpmc_ring {
+        jm::mpmc_circular_buffer<long long, capacity> ring;
+
+        bool try_push(long long value) { return ring.try_push(value); }
+        bool try_pop(long long& value) { return ring.try_pop(value); }
+
+        template<class F>
+        std::size_t push_batch(std::size_t count, F next)
+        {
+            const auto slots = ring.reserve(count);
+            for(std::size_t i = 0; i < slots.size(); ++i)
+                *slots[i] = next();
+            ring.commit(slots);
+            return slots.size();
+        }
+
+        template<class F>
+        std::size_t pop_batch(std::size_t count, F consume)
+        {
+            const auto items = ring.peek(count);
+            for(std::size_t i = 0; i < items.size(); ++i)
+                consume(*items[i]);
+            ring.release(items);
+            return items.size();
+        }
+    };
+
+    // what the concurrent rings replace
+    struct mutex_ring {
+        std::mutex                               mutex;
+        jm::circular_buffer<long long, capacity> ring;
+
+        bool try_push(long long value)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(ring.full())
+                return false;
+
+            ring.push_back(value);
+            return true;
+        }
+
+        bool try_pop(long long& value)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(ring.empty())
+                return false;
+
+            value = ring.front();
+            ring.pop_front();
+            return true;
+        }
+
+        // one lock per batch
+        template<class F>
+        std::size_t push_batch(std::size_t count, F next)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            count = std::min(count, ring.capacity() - ring.size());
+            for(std::size_t i = 0; i < count; ++i)
+                ring.push_back(next());
+            return count;
+        }
+
+        template<class F>
+        std::size_t pop_batch(std::size_t count, F consume)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            count = std::min(count, ring.size());
+            for(std::size_t i = 0; i < count; ++i)
+                consume(ring[i]);
+            ring.pop_front(count);
+            return count;
+        }
+    };
+
+    // pushes 0, ..., count - 1 from the producer and hands them to consume on the
+    // consumer, one at a time or in batches of up to batch elements
+    template<class Ring, class Consume>
+    void transfer(Ring&          ring,
+                  long long      count,
+                  std::size_t    batch,
+                  const options& opt,
+                  Consume        consume)
+    {
+        std::thread producer([&] {
+            pin_to(opt.producer_cpu);
+            long long next = 0;
+            while(next < count) {
+                if(batch == 0) {
+                    if(ring.try_push(next))
+                        ++next;
+                    else
+                        opt.wait();
+                    continue;
+                }
+
+                const std::size_t wanted =
+                    static_cast<std::size_t>(std::min<long long>(batch, count - next));
+                if(ring.push_batch(wanted, [&] { return next++; }) == 0)
+                    opt.wait();
+            }
+        });
+
+        pin_to(opt.consumer_cpu);
+        for(long long received = 0; received < count;) {
+            if(batch == 0) {
+                long long value;
+                if(ring.try_pop(value)) {
+                    consume(value);
+                    ++received;
+                }
+                else
+                    opt.wait();
+                continue;
+            }
+
+            const std::size_t n = ring.pop_batch(batch, consume);
+            if(n == 0)
+                opt.wait();
+            received += static_cast<long long>(n);
+        }
+
+        producer.join();
+    }
+
+    // samples are sorted once at the end, which is fine for a benchmark
+    void print_latencies(std::vector<std::uint64_t>& samples)
+    {
+        std::sort(samples.begin(), samples.end());
+        const auto at = [&](double q) {
+            return samples[static_cast<std::size_t>(q * static_cast<double>(samples.size() - 1))];
+        };
+
+        std::printf("    round trip ns  p50 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+                    static_cast<unsigned long long>(at(0.5)),
+                    static_cast<unsigned long long>(at(0.99)),
+                    static_cast<unsigned long long>(at(0.999)),
+                    static_cast<unsigned long long>(samples.back()));
+
+        // power of two buckets
+        std::size_t first = 0;
+        for(std::uint64_t bound = 64; first < samples.size(); bound *= 2) {
+            const std::size_t last = static_cast<std::size_t>(
+                std::upper_bound(samples.begin() + static_cast<std::ptrdiff_t>(first),
+                                 samples.end(),
+                                 bound - 1) -
+                samples.begin());
+            if(last != first)
+                std::printf("    < %8llu ns %10zu  %6.3f%%\n",
+                            static_cast<unsigned long long>(bound),
+                            last - first,
+                            100. * static_cast<double>(last - first) /
+                                static_cast<double>(samples.size()));
+            first = last;
+        }
+    }
+
+    template<class Ring>
+    void measure(const char* name, std::size_t batch, const options& opt)
+    {
+        std::printf("%s\n", name);
+
+        {
+            std::unique_ptr<Ring> ring(new Ring());
+            long long             sum   = 0;
+            const auto            start = clock_type::now();
+            transfer(*ring, opt.count, batch, opt, [&](long long value) { sum += value; });
+            const std::chrono::duration<double> elapsed = clock_type::now() - start;
+
+            std::printf("    throughput %.1f M elements/s ( checksum %lld )\n",
+                        static_cast<double>(opt.count) / elapsed.count() / 1e6,
+                        sum);
+        }
+
+        // the consumer echoes every timestamp back on a second ring
+        std::unique_ptr<Ring>      there(new Ring()), back(new Ring());
+        std::vector<std::uint64_t> samples;
+        samples.reserve(static_cast<std::size_t>(opt.round_trips));
+        std::thread echo([&] {
+            pin_to(opt.consumer_cpu);
+            long long value;
+            for(long long i = 0; i < opt.round_trips; ++i) {
+                while(!there->try_pop(value))
+                    opt.wait();
+                while(!back->try_push(value))
+                    opt.wait();
+            }
+        });
+
+        pin_to(opt.producer_cpu);
+        for(long long i = 0; i < opt.round_trips; ++i) {
+            const auto start = clock_type::now();
+            long long  value;
+            while(!there->try_push(i))
+                opt.wait();
+            while(!back->try_pop(value))
+                opt.wait();
+            samples.push_back(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start)
+                    .count()));
+        }
+
+        echo.join();
+        print_latencies(samples);
+    }
+
+    // single producer rings have to deliver every element in order
+    template<class Ring>
+    bool check_in_order(const char* name, std::size_t batch, const options& opt)
+    {
+        std::unique_ptr<Ring> ring(new Ring());
+        long long             expected = 0;
+        bool                  in_order = true;
+        transfer(*ring, opt.count, batch, opt, [&](long long value) {
+            in_order &= value == expected++;
+        });
+
+        std::printf("%-12s %s\n", name, in_order ? "ok" : "reordered or lost elements");
+        return in_order;
+    }
+
+    // with several producers and consumers only the sum is known
+    template<bool Batches>
+    bool check_mpmc(const char* name, const options& opt)
+    {
+        constexpr int   threads_per_side = 3;
+        const long long per_producer     = opt.count / threads_per_side;
+        const long long total            = per_producer * threads_per_side;
+
+        std::unique_ptr<mpmc_ring> ring(new mpmc_ring());
+        std::atomic<long long>     sum{0}, received{0};
+        std::vector<std::thread>   threads;
+        // more threads than cpus are likely, so failed attempts yield
+        for(int p = 0; p < threads_per_side; ++p)
+            threads.emplace_back([&, p] {
+                long long       next = p * per_producer;
+                const long long last = next + per_producer;
+                while(next < last) {
+                    std::size_t pushed = 0;
+                    if(!Batches)
+                        pushed = ring->try_push(next) ? (++next, 1) : 0;
+                    else
+                        pushed = ring->push_batch(
+                            static_cast<std::size_t>(std::min<long long>(7, last - next)),
+                            [&] { return next++; });
+
+                    if(pushed == 0)
+                        std::this_thread::yield();
+                }
+            });
+
+        for(int c = 0; c < threads_per_side; ++c)
+            threads.emplace_back([&] {
+                long long local = 0;
+                while(received.load(std::memory_order_relaxed) < total) {
+                    long long   value;
+                    std::size_t popped = 0;
+                    if(!Batches) {
+                        if(ring->try_pop(value)) {
+                            local += value;
+                            popped = 1;
+                        }
+                    }
+                    else
+                        popped = ring->pop_batch(5, [&](long long v) { local += v; });
+
+                    if(popped == 0)
+                        std::this_thread::yield();
+                    received.fetch_add(static_cast<long long>(popped), std::memory_order_relaxed);
+                }
+                sum += local;
+            });
+
+        for(auto& thread : threads)
+            thread.join();
+
+        const bool ok = sum == total * (total - 1) / 2;
+        std::printf("%-12s %s\n", name, ok ? "ok" : "lost or duplicated elements");
+        return ok;
+    }
+
+    bool wanted(const options& opt, const char* name)
+    {
+        return opt.ring.empty() || opt.ring == name;
+    }
+
+    bool parse(int argc, char** argv, options& opt)
+    {
+        for(int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool        has_value = i + 1 < argc;
+            if(arg == "--check")
+                opt.check = true;
+            else if(arg == "--producer-cpu" && has_value)
+                opt.producer_cpu = std::atoi(argv[++i]);
+            else if(arg == "--consumer-cpu" && has_value)
+                opt.consumer_cpu = std::atoi(argv[++i]);
+            else if(arg == "--count" && has_value)
+                opt.count = std::atoll(argv[++i]);
+            else if(arg == "--round-trips" && has_value)
+                opt.round_trips = std::atoll(argv[++i]);
+            else if(arg == "--ring" && has_value)
+                opt.ring = argv[++i];
+            else {
+                std::fprintf(stderr, "unknown argument %s\n", arg.c_str());
+                return false;
+            }
+        }
+
+        return opt.count > 0 && opt.round_trips > 0;
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    options opt;
+    if(!parse(argc, argv, opt))
+        return EXIT_FAILURE;
+
+    if(opt.check) {
+        // small enough for sanitizer builds
+        opt.count     = 60000;
+        opt.share_cpu = true;
+
+        bool ok = true;
+        ok &= check_in_order<spsc_ring>("spsc", 0, opt);
+        ok &= check_in_order<spsc_ring>("spsc_batch", 13, opt);
+        ok &= check_in_order<mutex_ring>("mutex", 0, opt);
+        ok &= check_in_order<mutex_ring>("mutex_batch", 13, opt);
+        ok &= check_mpmc<false>("mpmc", opt);
+        ok &= check_mpmc<true>("mpmc_batch", opt);
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    opt.share_cpu = std::thread::hardware_concurrency() < 2 ||
+                    (opt.producer_cpu >= 0 && opt.producer_cpu == opt.consumer_cpu);
+
+    std::printf("producer cpu %d, consumer cpu %d, %lld elements, %lld round trips\n",
+                opt.producer_cpu,
+                opt.consumer_cpu,
+                opt.count,
+                opt.round_trips);
+
+    if(wanted(opt, "spsc"))
+        measure<spsc_ring>("spsc", 0, opt);
+    if(wanted(opt, "spsc_batch"))
+        measure<spsc_ring>("spsc_batch", 64, opt);
+    if(wanted(opt, "mpmc"))
+        measure<mpmc_ring>("mpmc", 0, opt);
+    if(wanted(opt, "mpmc_batch"))
+        measure<mpmc_ring>("mpmc_batch", 64, opt);
+    if(wanted(opt, "mutex"))
+        measure<mutex_ring>("mutex", 0, opt);
+    if(wanted(opt, "mutex_batch"))
+        measure<mutex_ring>("mutex_batch", 64, opt);
+
+    return EXIT_SUCCESS;
+}
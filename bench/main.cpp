@@ -0,0 +1,340 @@
+#define JM_CIRCULAR_BUFFER_CXX14
+#include <circular_buffer.hpp>
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(JM_CB_BENCH_HAS_BOOST)
+#include <boost/circular_buffer.hpp>
+#endif
+
+// element of a configurable size to see how the buffers scale with it
+template<std::size_t Size>
+struct blob {
+    unsigned char bytes[Size];
+
+    blob() = default;
+    explicit blob(unsigned char value) { std::fill(bytes, bytes + Size, value); }
+
+    int key() const { return bytes[0]; }
+};
+
+inline int key(int value) { return value; }
+
+template<std::size_t Size>
+inline int key(const blob<Size>& value)
+{
+    return value.key();
+}
+
+template<class T>
+T make(int value)
+{
+    return T(static_cast<unsigned char>(value));
+}
+
+template<>
+int make<int>(int value)
+{
+    return value;
+}
+
+// the buffers are heap allocated so that big ones don't overflow the stack
+template<class T, std::size_t N>
+std::unique_ptr<jm::circular_buffer<T, N>> make_buffer()
+{
+    return std::unique_ptr<jm::circular_buffer<T, N>>(new jm::circular_buffer<T, N>());
+}
+
+/// push_back into a buffer that never fills up
+template<class T, std::size_t N>
+void push_pop_not_full(benchmark::State& state)
+{
+    auto      cb    = make_buffer<T, N>();
+    const T   value = make<T>(1);
+    for(std::size_t i = 0; i < N / 2; ++i)
+        cb->push_back(value);
+
+    for(auto _ : state) {
+        cb->push_back(value);
+        cb->pop_front();
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+/// push_back into a full buffer that overwrites the front
+template<class T, std::size_t N>
+void push_back_full(benchmark::State& state)
+{
+    auto    cb    = make_buffer<T, N>();
+    const T value = make<T>(1);
+    for(std::size_t i = 0; i < N; ++i)
+        cb->push_back(value);
+
+    for(auto _ : state) {
+        cb->push_back(value);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+template<class T, std::size_t N>
+void emplace_back_full(benchmark::State& state)
+{
+    auto cb = make_buffer<T, N>();
+    for(std::size_t i = 0; i < N; ++i)
+        cb->emplace_back(make<T>(1));
+
+    for(auto _ : state) {
+        cb->emplace_back(make<T>(2));
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+template<class T, std::size_t N>
+void append_full(benchmark::State& state)
+{
+    auto           cb = make_buffer<T, N>();
+    std::vector<T> src(N / 2, make<T>(3));
+    for(auto _ : state) {
+        cb->append(src.data(), src.size());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(src.size()));
+}
+
+/// iteration over a wrapped around buffer compared with the other containers
+template<class T, std::size_t N>
+void iterate(benchmark::State& state)
+{
+    auto cb = make_buffer<T, N>();
+    for(std::size_t i = 0; i < N + N / 2; ++i)
+        cb->push_back(make<T>(static_cast<int>(i)));
+
+    for(auto _ : state) {
+        int sum = 0;
+        for(const auto& v : *cb)
+            sum += key(v);
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(N));
+}
+
+template<class T, std::size_t N>
+void iterate_deque(benchmark::State& state)
+{
+    std::deque<T> d;
+    for(std::size_t i = 0; i < N + N / 2; ++i) {
+        d.push_back(make<T>(static_cast<int>(i)));
+        if(d.size() > N)
+            d.pop_front();
+    }
+
+    for(auto _ : state) {
+        int sum = 0;
+        for(const auto& v : d)
+            sum += key(v);
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(N));
+}
+
+template<class T, std::size_t N>
+void push_pop_deque(benchmark::State& state)
+{
+    std::deque<T> d(N / 2, make<T>(1));
+    const T       value = make<T>(1);
+    for(auto _ : state) {
+        d.push_back(value);
+        d.pop_front();
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+#if defined(JM_CB_BENCH_HAS_BOOST)
+
+template<class T, std::size_t N>
+void iterate_boost(benchmark::State& state)
+{
+    boost::circular_buffer<T> cb(N);
+    for(std::size_t i = 0; i < N + N / 2; ++i)
+        cb.push_back(make<T>(static_cast<int>(i)));
+
+    for(auto _ : state) {
+        int sum = 0;
+        for(const auto& v : cb)
+            sum += key(v);
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(N));
+}
+
+template<class T, std::size_t N>
+void push_back_full_boost(benchmark::State& state)
+{
+    boost::circular_buffer<T> cb(N, make<T>(1));
+    const T                   value = make<T>(1);
+    for(auto _ : state) {
+        cb.push_back(value);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+#endif // defined(JM_CB_BENCH_HAS_BOOST)
+
+template<class T, std::size_t N>
+void copy_construct(benchmark::State& state)
+{
+    auto cb = make_buffer<T, N>();
+    for(std::size_t i = 0; i < N + N / 2; ++i)
+        cb->push_back(make<T>(static_cast<int>(i)));
+
+    for(auto _ : state) {
+        auto copy = std::unique_ptr<jm::circular_buffer<T, N>>(new jm::circular_buffer<T, N>(*cb));
+        benchmark::DoNotOptimize(copy.get());
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(N));
+}
+
+template<class T, std::size_t N>
+void move_construct(benchmark::State& state)
+{
+    auto cb = make_buffer<T, N>();
+    for(std::size_t i = 0; i < N + N / 2; ++i)
+        cb->push_back(make<T>(static_cast<int>(i)));
+
+    for(auto _ : state) {
+        auto moved = std::unique_ptr<jm::circular_buffer<T, N>>(
+            new jm::circular_buffer<T, N>(std::move(*cb)));
+        benchmark::DoNotOptimize(moved.get());
+        cb = std::move(moved);
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(N));
+}
+
+template<class T>
+void dynamic_push_back_full(benchmark::State& state)
+{
+    jm::dynamic_circular_buffer<T> cb(static_cast<std::size_t>(state.range(0)));
+    const T                        value = make<T>(1);
+    for(std::size_t i = 0; i < cb.capacity(); ++i)
+        cb.push_back(value);
+
+    for(auto _ : state) {
+        cb.push_back(value);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+/// one producer and one consumer thread moving range(0) elements per iteration
+template<class T, std::size_t N>
+void spsc_throughput(benchmark::State& state)
+{
+    typedef jm::spsc_circular_buffer<T, N> ring_t;
+
+    const auto count = static_cast<std::size_t>(state.range(0));
+    auto       ring  = std::unique_ptr<ring_t>(new ring_t());
+    const T    value = make<T>(1);
+
+    for(auto _ : state) {
+        std::thread producer([&] {
+            for(std::size_t i = 0; i < count;)
+                if(ring->try_push(value))
+                    ++i;
+                else
+                    std::this_thread::yield();
+        });
+
+        T out = make<T>(0);
+        for(std::size_t i = 0; i < count;)
+            if(ring->try_pop(out))
+                ++i;
+            else
+                std::this_thread::yield();
+
+        producer.join();
+        benchmark::DoNotOptimize(out);
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(count));
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(count * sizeof(T)));
+}
+
+/// stages chunks in a buffer much larger than the cache while summing a working set
+/// that fits into it, to compare how much of the working set each policy evicts
+template<class Streaming>
+void streaming_append(benchmark::State& state)
+{
+    typedef jm::circular_buffer<int, (1 << 21), 0, Streaming> buffer_t;
+
+    auto             cb = std::unique_ptr<buffer_t>(new buffer_t());
+    std::vector<int> chunk(4096, 1);
+    std::vector<int> working_set(static_cast<std::size_t>(state.range(0)), 1);
+
+    for(auto _ : state) {
+        cb->append(chunk.data(), chunk.size());
+        cb->pop_front(chunk.size() / 2);
+
+        long long sum = 0;
+        for(int value : working_set)
+            sum += value;
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(chunk.size() * sizeof(int)));
+}
+
+#define JM_CB_BENCH_SIZES(name)                               \
+    BENCHMARK_TEMPLATE(name, int, 16);                        \
+    BENCHMARK_TEMPLATE(name, int, 1000);                      \
+    BENCHMARK_TEMPLATE(name, int, 1024);                      \
+    BENCHMARK_TEMPLATE(name, blob<64>, 16);                   \
+    BENCHMARK_TEMPLATE(name, blob<64>, 1024)
+
+JM_CB_BENCH_SIZES(push_pop_not_full);
+JM_CB_BENCH_SIZES(push_pop_deque);
+JM_CB_BENCH_SIZES(push_back_full);
+JM_CB_BENCH_SIZES(emplace_back_full);
+JM_CB_BENCH_SIZES(append_full);
+JM_CB_BENCH_SIZES(iterate);
+JM_CB_BENCH_SIZES(iterate_deque);
+JM_CB_BENCH_SIZES(copy_construct);
+JM_CB_BENCH_SIZES(move_construct);
+
+#if defined(JM_CB_BENCH_HAS_BOOST)
+JM_CB_BENCH_SIZES(iterate_boost);
+JM_CB_BENCH_SIZES(push_back_full_boost);
+#endif
+
+BENCHMARK_TEMPLATE(dynamic_push_back_full, int)->Arg(16)->Arg(1000)->Arg(1024);
+BENCHMARK_TEMPLATE(dynamic_push_back_full, blob<64>)->Arg(16)->Arg(1024);
+
+BENCHMARK_TEMPLATE(streaming_append, jm::no_streaming)->Arg(1 << 14);
+BENCHMARK_TEMPLATE(streaming_append, jm::streaming<64>)->Arg(1 << 14);
+
+BENCHMARK_TEMPLATE(spsc_throughput, int, 1024)->Arg(1 << 16)->UseRealTime();
+BENCHMARK_TEMPLATE(spsc_throughput, blob<64>, 1024)->Arg(1 << 16)->UseRealTime();
+
+BENCHMARK_MAIN();
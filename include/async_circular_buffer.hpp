@@ -0,0 +1,376 @@
+/*
+ * Copyright 2017 Justas Masiulis
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JM_ASYNC_CIRCULAR_BUFFER_HPP
+#define JM_ASYNC_CIRCULAR_BUFFER_HPP
+
+#include "circular_buffer.hpp"
+#include <coroutine>
+#include <mutex>
+#include <optional>
+
+#if !defined(__cpp_impl_coroutine)
+#error "async_circular_buffer requires c++20 coroutines"
+#endif
+
+namespace jm {
+
+    namespace detail {
+
+        // suspended coroutines are linked through their awaiters, which live in the
+        // coroutine frames, so waiting allocates nothing
+        struct cb_waiter {
+            std::coroutine_handle<> handle;
+            cb_waiter*              next = nullptr;
+        };
+
+        template<class Waiter>
+        class cb_waiter_list {
+            Waiter* _first = nullptr;
+            Waiter* _last  = nullptr;
+
+        public:
+            bool empty() const noexcept { return _first == nullptr; }
+
+            void push_back(Waiter* waiter) noexcept
+            {
+                waiter->next = nullptr;
+                if(_last)
+                    _last->next = waiter;
+                else
+                    _first = waiter;
+                _last = waiter;
+            }
+
+            Waiter* pop_front() noexcept
+            {
+                Waiter* waiter = _first;
+                _first         = static_cast<Waiter*>(waiter->next);
+                if(_first == nullptr)
+                    _last = nullptr;
+                return waiter;
+            }
+
+            // resumes every waiter in order, the list has to be detached from the
+            // channel first since the waiters may use it again
+            void resume_all() noexcept
+            {
+                while(!empty())
+                    pop_front()->handle.resume();
+            }
+        };
+
+    } // namespace detail
+
+    /// bounded channel between coroutines on top of circular_buffer.
+    /// co_await push(value) suspends while the channel is full and co_await pop()
+    /// while it is empty. A value pushed while a consumer is waiting is handed to it
+    /// directly. Woken coroutines are resumed by the thread that woke them before
+    /// its operation completes, so there are no syscalls or context switches. The
+    /// channel may be used from any number of threads.
+    template<class T, std::size_t N>
+    class async_circular_buffer {
+        // without a slot pushers and poppers would wait for each other forever
+        static_assert(N > 0, "the capacity has to be at least 1");
+
+        struct push_waiter : detail::cb_waiter {
+            T*   value;
+            bool pushed;
+        };
+
+        struct pop_waiter : detail::cb_waiter {
+            std::optional<T>* single;
+            T*                many;
+            std::size_t       count;
+        };
+
+        typedef detail::cb_waiter_list<push_waiter> push_list;
+        typedef detail::cb_waiter_list<pop_waiter>  pop_list;
+
+        mutable std::mutex    _mutex;
+        circular_buffer<T, N> _buffer;
+        push_list             _pushers; // only waiting while the buffer is full
+        pop_list              _poppers; // only waiting while the buffer is empty
+        bool                  _closed = false;
+
+        static void deliver(pop_waiter& waiter, T&& value)
+        {
+            if(waiter.single)
+                waiter.single->emplace(std::move(value));
+            else
+                waiter.many[0] = std::move(value);
+            waiter.count = 1;
+        }
+
+        // moves the values of waiting pushers into the space that popping made
+        void refill(push_list& woken)
+        {
+            while(!_pushers.empty() && !_buffer.full()) {
+                push_waiter* waiter = _pushers.pop_front();
+                _buffer.push_back(std::move(*waiter->value));
+                waiter->pushed = true;
+                woken.push_back(waiter);
+            }
+        }
+
+        class push_awaiter {
+            async_circular_buffer&       _channel;
+            push_waiter                  _waiter;
+            T                            _value;
+            std::unique_lock<std::mutex> _lock;
+            pop_waiter*                  _woken = nullptr;
+
+        public:
+            push_awaiter(async_circular_buffer& channel, T&& value)
+                : _channel(channel), _value(std::move(value))
+            {
+                _waiter.pushed = false;
+            }
+
+            // the lock is held until the coroutine is queued in await_suspend
+            bool await_ready()
+            {
+                _lock = std::unique_lock<std::mutex>(_channel._mutex);
+                if(_channel._closed)
+                    return true;
+
+                if(!_channel._poppers.empty()) {
+                    _woken = _channel._poppers.pop_front();
+                    deliver(*_woken, std::move(_value));
+                }
+                else if(!_channel._buffer.full())
+                    _channel._buffer.push_back(std::move(_value));
+                else
+                    return false;
+
+                _waiter.pushed = true;
+                return true;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept
+            {
+                _waiter.handle = handle;
+                _waiter.value  = std::addressof(_value);
+                _channel._pushers.push_back(std::addressof(_waiter));
+
+                // this coroutine may be resumed and finished as soon as the mutex is
+                // unlocked, so the awaiter is not touched after that
+                _lock.release()->unlock();
+            }
+
+            /// false if the channel was closed, the value was dropped then
+            bool await_resume() noexcept
+            {
+                if(_lock.owns_lock())
+                    _lock.unlock();
+                if(_woken)
+                    _woken->handle.resume();
+                return _waiter.pushed;
+            }
+        };
+
+        class pop_awaiter {
+            async_circular_buffer&       _channel;
+            pop_waiter                   _waiter;
+            std::optional<T>             _value;
+            std::unique_lock<std::mutex> _lock;
+            push_list                    _woken;
+
+        public:
+            pop_awaiter(async_circular_buffer& channel, T* out, std::size_t max_count)
+                : _channel(channel)
+            {
+                _waiter.single = out ? nullptr : std::addressof(_value);
+                _waiter.many   = out;
+                _waiter.count  = max_count;
+            }
+
+            bool await_ready()
+            {
+                _lock = std::unique_lock<std::mutex>(_channel._mutex);
+
+                circular_buffer<T, N>& buffer = _channel._buffer;
+                if(buffer.empty()) {
+                    _waiter.count = 0;
+                    return _channel._closed;
+                }
+
+                if(_waiter.single) {
+                    _value.emplace(std::move(buffer.front()));
+                    buffer.pop_front();
+                    _waiter.count = 1;
+                }
+                else {
+                    const std::size_t count =
+                        (_waiter.count < buffer.size()) ? _waiter.count : buffer.size();
+                    std::move(buffer.begin(), buffer.begin() + count, _waiter.many);
+                    buffer.pop_front(count);
+                    _waiter.count = count;
+                }
+
+                _channel.refill(_woken);
+                return true;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept
+            {
+                _waiter.handle = handle;
+                if(_waiter.single)
+                    _waiter.single = std::addressof(_value);
+                _channel._poppers.push_back(std::addressof(_waiter));
+                _lock.release()->unlock();
+            }
+
+            std::size_t finish() noexcept
+            {
+                if(_lock.owns_lock())
+                    _lock.unlock();
+                _woken.resume_all();
+                return _waiter.count;
+            }
+
+            std::optional<T> resume_single() noexcept
+            {
+                finish();
+                return std::move(_value);
+            }
+        };
+
+    public:
+        typedef T           value_type;
+        typedef std::size_t size_type;
+
+        async_circular_buffer() = default;
+
+        async_circular_buffer(const async_circular_buffer&) = delete;
+        async_circular_buffer& operator=(const async_circular_buffer&) = delete;
+
+        /// awaits space for value, resumes with false instead if the channel gets closed
+        [[nodiscard]] push_awaiter push(T value) { return push_awaiter(*this, std::move(value)); }
+
+        /// awaits a value, resumes with an empty optional once the channel is closed
+        /// and drained
+        [[nodiscard]] auto pop()
+        {
+            struct awaiter : pop_awaiter {
+                using pop_awaiter::pop_awaiter;
+
+                std::optional<T> await_resume() noexcept { return this->resume_single(); }
+            };
+
+            return awaiter(*this, nullptr, 1);
+        }
+
+        /// awaits at least one value and moves up to max_count available ones to out,
+        /// resumes with their number, which is 0 once the channel is closed and drained.
+        /// max_count must be at least 1, throws std::invalid_argument otherwise
+        [[nodiscard]] auto pop_n(T* out, size_type max_count)
+        {
+            if(max_count == 0)
+                throw std::invalid_argument("async_circular_buffer::pop_n max_count of 0");
+
+            struct awaiter : pop_awaiter {
+                using pop_awaiter::pop_awaiter;
+
+                size_type await_resume() noexcept { return this->finish(); }
+            };
+
+            return awaiter(*this, out, max_count);
+        }
+
+        /// pushes without waiting, false if the channel is full or closed
+        bool try_push(T value)
+        {
+            pop_waiter* woken = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if(_closed)
+                    return false;
+
+                if(!_poppers.empty()) {
+                    woken = _poppers.pop_front();
+                    deliver(*woken, std::move(value));
+                }
+                else if(!_buffer.full())
+                    _buffer.push_back(std::move(value));
+                else
+                    return false;
+            }
+
+            if(woken)
+                woken->handle.resume();
+            return true;
+        }
+
+        /// pops without waiting, an empty optional if the channel is empty
+        std::optional<T> try_pop()
+        {
+            std::optional<T> value;
+            push_list        woken;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if(_buffer.empty())
+                    return value;
+
+                value.emplace(std::move(_buffer.front()));
+                _buffer.pop_front();
+                refill(woken);
+            }
+
+            woken.resume_all();
+            return value;
+        }
+
+        /// wakes every waiter, pushes fail from now on while pops return what is left
+        void close()
+        {
+            push_list pushers;
+            pop_list  poppers;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _closed = true;
+                std::swap(pushers, _pushers);
+                std::swap(poppers, _poppers);
+            }
+
+            pushers.resume_all();
+            poppers.resume_all();
+        }
+
+        bool closed() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _closed;
+        }
+
+        bool empty() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _buffer.empty();
+        }
+
+        size_type size() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _buffer.size();
+        }
+
+        constexpr size_type capacity() const noexcept { return N; }
+    };
+
+} // namespace jm
+
+#endif // JM_ASYNC_CIRCULAR_BUFFER_HPP
@@ -20,26 +20,58 @@
 #include <iterator>
 #include <algorithm>
 #include <stdexcept>
+#include <utility>
+#include <cstring>
+#include <climits>
+#include <new>
 
 #if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
 #include <type_traits>
 #include <initializer_list>
+#include <atomic>
+#include <thread>
+#include <memory>
 #endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
 
+#if defined(__has_include) && __cplusplus >= 201703L
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+// non temporal stores of streaming buffers, see jm::streaming
+#if !defined(JM_CIRCULAR_BUFFER_NO_SIMD) &&                                                \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JM_CB_STREAM_SSE2
+#include <emmintrin.h>
+#endif
+
 
 #ifndef JM_CIRCULAR_BUFFER_CXX_OLD
 #define JM_CB_CONSTEXPR constexpr
 #define JM_CB_NOEXCEPT noexcept
 #define JM_CB_NULLPTR nullptr
 #define JM_CB_ADDRESSOF(x) ::std::addressof(x)
+#define JM_CB_MOVE(x) ::std::move(x)
 #define JM_CB_IS_TRIVIALLY_DESTRUCTIBLE(type) \
     ::std::is_trivially_destructible<type>::value
+#define JM_CB_IS_TRIVIALLY_COPYABLE(type) ::std::is_trivially_copyable<type>::value
 #else
 #define JM_CB_CONSTEXPR
 #define JM_CB_NOEXCEPT
 #define JM_CB_NULLPTR NULL
 #define JM_CB_ADDRESSOF(x) &(x)
+#define JM_CB_MOVE(x) (x)
 #define JM_CB_IS_TRIVIALLY_DESTRUCTIBLE(type) false
+#define JM_CB_IS_TRIVIALLY_COPYABLE(type) false
+#endif
+
+#if defined(JM_CIRCULAR_BUFFER_CXX20) && !defined(JM_CIRCULAR_BUFFER_CXX14)
+#define JM_CIRCULAR_BUFFER_CXX14
 #endif
 
 #ifdef JM_CIRCULAR_BUFFER_CXX14
@@ -50,6 +82,17 @@
 #define JM_CB_CXX14_INIT_0
 #endif
 
+// constructs and destroys through std::construct_at and std::destroy_at so that
+// everything, including emplace and non trivial types, works in constant expressions
+#ifdef JM_CIRCULAR_BUFFER_CXX20
+#if !((defined(_MSVC_LANG) && _MSVC_LANG >= 202002L) || __cplusplus >= 202002L)
+#error "JM_CIRCULAR_BUFFER_CXX20 requires c++20"
+#endif
+#define JM_CB_CXX20_CONSTEXPR constexpr
+#else
+#define JM_CB_CXX20_CONSTEXPR
+#endif
+
 #if defined(__GNUC__)
 #define JM_CB_LIKELY(x) __builtin_expect(x, 1)
 #define JM_CB_UNLIKELY(x) __builtin_expect(x, 0)
@@ -81,23 +124,526 @@
 #endif
 
 
+#ifndef JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE // used to keep state written by different
+                                           // threads apart
+#define JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE 64
+#endif
+
+
 namespace jm {
 
+#if defined(JM_CIRCULAR_BUFFER_STATISTICS)
+
+    /// what a buffer went through since it was constructed or reset_statistics() was
+    /// called. The counters are plain members so they cost an add on every operation,
+    /// they are only compiled in when JM_CIRCULAR_BUFFER_STATISTICS is defined.
+    struct circular_buffer_statistics {
+        std::size_t pushes;     // elements added, including the ones that overwrote
+        std::size_t overwrites; // elements added while the buffer was full
+        std::size_t rejected;   // try_push and try_emplace calls that found it full
+        std::size_t pops;       // elements removed by pop_front, pop_back and clear
+        std::size_t peak_size;  // largest size
+    };
+
+#endif // defined(JM_CIRCULAR_BUFFER_STATISTICS)
+
+    /// streaming policy of circular_buffer, for buffers much larger than the cache that
+    /// are written and read once. Pushes prefetch the slot PrefetchDistance elements
+    /// after the back for writing and pops the one as far after the front for
+    /// reading, 0 disables it. NonTemporal makes append() of trivially copyable
+    /// elements write around the cache and fence afterwards where the target has such
+    /// stores, so the staged data does not evict the working set of the producer.
+    template<std::size_t PrefetchDistance, bool NonTemporal = true>
+    struct streaming {
+        static const std::size_t prefetch_distance = PrefetchDistance;
+        static const bool        non_temporal      = NonTemporal;
+    };
+
+    /// the default policy, the buffer is written through the cache without hints
+    typedef streaming<0, false> no_streaming;
+
     namespace detail {
 
+#if defined(JM_CIRCULAR_BUFFER_STATISTICS)
+
+        class cb_statistics_recorder {
+            circular_buffer_statistics _statistics;
+
+        protected:
+            JM_CB_CONSTEXPR cb_statistics_recorder() : _statistics() {}
+
+            JM_CB_CXX14_CONSTEXPR void record_push(std::size_t count,
+                                                   std::size_t size) JM_CB_NOEXCEPT
+            {
+                _statistics.pushes += count;
+                if(size > _statistics.peak_size)
+                    _statistics.peak_size = size;
+            }
+
+            JM_CB_CXX14_CONSTEXPR void record_overwrite(std::size_t count) JM_CB_NOEXCEPT
+            {
+                _statistics.pushes += count;
+                _statistics.overwrites += count;
+            }
+
+            JM_CB_CXX14_CONSTEXPR void record_rejected() JM_CB_NOEXCEPT
+            {
+                ++_statistics.rejected;
+            }
+
+            JM_CB_CXX14_CONSTEXPR void record_pop(std::size_t count) JM_CB_NOEXCEPT
+            {
+                _statistics.pops += count;
+            }
+
+            JM_CB_CXX14_CONSTEXPR void reset_statistics(std::size_t size) JM_CB_NOEXCEPT
+            {
+                _statistics           = circular_buffer_statistics();
+                _statistics.peak_size = size;
+            }
+
+        public:
+            /// snapshot of the counters
+            JM_CB_CONSTEXPR circular_buffer_statistics statistics() const JM_CB_NOEXCEPT
+            {
+                return _statistics;
+            }
+        };
+
+#else
+
+        // empty so that the hooks compile away
+        class cb_statistics_recorder {
+        protected:
+            JM_CB_CXX14_CONSTEXPR void record_push(std::size_t, std::size_t) JM_CB_NOEXCEPT {}
+            JM_CB_CXX14_CONSTEXPR void record_overwrite(std::size_t) JM_CB_NOEXCEPT {}
+            JM_CB_CXX14_CONSTEXPR void record_rejected() JM_CB_NOEXCEPT {}
+            JM_CB_CXX14_CONSTEXPR void record_pop(std::size_t) JM_CB_NOEXCEPT {}
+        };
+
+#endif // defined(JM_CIRCULAR_BUFFER_STATISTICS)
+
         template<class size_type, size_type N>
+        struct cb_is_power_of_two {
+            static const bool value = N != 0 && (N & (N - 1)) == 0;
+        };
+
+        // generic version that wraps around using a compare and reset instead of modulo
+        template<class size_type,
+                 size_type N,
+                 bool = cb_is_power_of_two<size_type, N>::value>
         struct cb_index_wrapper {
             inline static JM_CB_CONSTEXPR size_type increment(size_type value)
                 JM_CB_NOEXCEPT
             {
-                return (value + 1) % N;
+                return (value + 1 == N) ? 0 : value + 1;
+            }
+
+            inline static JM_CB_CONSTEXPR size_type decrement(size_type value)
+                JM_CB_NOEXCEPT
+            {
+                return (value == 0) ? N - 1 : value - 1;
+            }
+
+            // n must be in the range of [-N, N]
+            inline static JM_CB_CONSTEXPR size_type advance(size_type      value,
+                                                            std::ptrdiff_t n) JM_CB_NOEXCEPT
+            {
+                return (n >= 0) ? ((value + static_cast<size_type>(n) >= N)
+                                       ? value + static_cast<size_type>(n) - N
+                                       : value + static_cast<size_type>(n))
+                                : ((value >= static_cast<size_type>(-n))
+                                       ? value - static_cast<size_type>(-n)
+                                       : value + N - static_cast<size_type>(-n));
+            }
+
+            inline static JM_CB_CONSTEXPR size_type index(size_type value) JM_CB_NOEXCEPT
+            {
+                return value;
+            }
+
+            inline static JM_CB_CONSTEXPR size_type capacity() JM_CB_NOEXCEPT { return N; }
+        };
+
+        template<class size_type, size_type N>
+        struct cb_index_wrapper<size_type, N, true /* power of two */> {
+            inline static JM_CB_CONSTEXPR size_type increment(size_type value)
+                JM_CB_NOEXCEPT
+            {
+                return (value + 1) & (N - 1);
+            }
+
+            inline static JM_CB_CONSTEXPR size_type decrement(size_type value)
+                JM_CB_NOEXCEPT
+            {
+                return (value - 1) & (N - 1);
+            }
+
+            inline static JM_CB_CONSTEXPR size_type advance(size_type      value,
+                                                            std::ptrdiff_t n) JM_CB_NOEXCEPT
+            {
+                return (value + static_cast<size_type>(n)) & (N - 1);
+            }
+
+            inline static JM_CB_CONSTEXPR size_type index(size_type value) JM_CB_NOEXCEPT
+            {
+                return value;
+            }
+
+            inline static JM_CB_CONSTEXPR size_type capacity() JM_CB_NOEXCEPT { return N; }
+        };
+
+        // indices are never wrapped and only reduced when a slot is accessed.
+        // only valid for powers of two because the index type overflowing needs to
+        // land on the same slot.
+        template<class size_type, size_type N>
+        struct cb_monotonic_index_wrapper {
+            inline static JM_CB_CONSTEXPR size_type increment(size_type value)
+                JM_CB_NOEXCEPT
+            {
+                return value + 1;
             }
 
             inline static JM_CB_CONSTEXPR size_type decrement(size_type value)
                 JM_CB_NOEXCEPT
             {
-                return (value + N - 1) % N;
+                return value - 1;
+            }
+
+            inline static JM_CB_CONSTEXPR size_type advance(size_type      value,
+                                                            std::ptrdiff_t n) JM_CB_NOEXCEPT
+            {
+                return value + static_cast<size_type>(n);
+            }
+
+            inline static JM_CB_CONSTEXPR size_type index(size_type value) JM_CB_NOEXCEPT
+            {
+                return value & (N - 1);
+            }
+        };
+
+        template<class size_type, size_type N>
+        struct cb_select_index_wrapper {
+#if defined(JM_CIRCULAR_BUFFER_MONOTONIC_INDEX) && !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+            typedef typename std::conditional<cb_is_power_of_two<size_type, N>::value,
+                                              cb_monotonic_index_wrapper<size_type, N>,
+                                              cb_index_wrapper<size_type, N>>::type type;
+#else
+            typedef cb_index_wrapper<size_type, N> type;
+#endif
+        };
+
+        template<class Wrapper>
+        struct cb_is_monotonic {
+            static const bool value = false;
+        };
+
+        template<class size_type, size_type N>
+        struct cb_is_monotonic<cb_monotonic_index_wrapper<size_type, N>> {
+            static const bool value = true;
+        };
+
+        // the narrowest unsigned type that can hold every value in [0, N]
+        template<std::size_t N,
+                 int = (N <= UCHAR_MAX) ? 0 : (N <= USHRT_MAX) ? 1 : (N <= UINT_MAX) ? 2 : 3>
+        struct cb_index_type {
+            typedef std::size_t type;
+        };
+
+        template<std::size_t N>
+        struct cb_index_type<N, 0> {
+            typedef unsigned char type;
+        };
+
+        template<std::size_t N>
+        struct cb_index_type<N, 1> {
+            typedef unsigned short type;
+        };
+
+        template<std::size_t N>
+        struct cb_index_type<N, 2> {
+            typedef unsigned int type;
+        };
+
+        // head, tail and the number of elements between them.
+        // Indices are computed as std::size_t and stored truncated to index_type.
+        template<class index_type, bool = false /* monotonic */>
+        struct cb_indices {
+            index_type _head;
+            index_type _tail;
+            index_type _size;
+
+            explicit JM_CB_CONSTEXPR cb_indices(std::size_t head) JM_CB_NOEXCEPT
+                : _head(static_cast<index_type>(head)),
+                  _tail(0),
+                  _size(0)
+            {}
+
+            JM_CB_CONSTEXPR std::size_t stored_size() const JM_CB_NOEXCEPT { return _size; }
+
+            JM_CB_CXX14_CONSTEXPR void grow_size(std::size_t n) JM_CB_NOEXCEPT
+            {
+                _size = static_cast<index_type>(_size + n);
+            }
+
+            JM_CB_CXX14_CONSTEXPR void shrink_size(std::size_t n) JM_CB_NOEXCEPT
+            {
+                _size = static_cast<index_type>(_size - n);
+            }
+
+            JM_CB_CXX14_CONSTEXPR void reset_size() JM_CB_NOEXCEPT { _size = 0; }
+        };
+
+        // monotonic indices never wrap, so the size is their distance and does not
+        // have to be stored or updated. index_type overflowing is fine as long as it
+        // can represent N.
+        template<class index_type>
+        struct cb_indices<index_type, true /* monotonic */> {
+            index_type _head;
+            index_type _tail;
+
+            explicit JM_CB_CONSTEXPR cb_indices(std::size_t head) JM_CB_NOEXCEPT
+                : _head(static_cast<index_type>(head)),
+                  _tail(0)
+            {}
+
+            JM_CB_CONSTEXPR std::size_t stored_size() const JM_CB_NOEXCEPT
+            {
+                return static_cast<index_type>(_tail + 1u - _head);
+            }
+
+            JM_CB_CXX14_CONSTEXPR void grow_size(std::size_t) JM_CB_NOEXCEPT {}
+
+            JM_CB_CXX14_CONSTEXPR void shrink_size(std::size_t) JM_CB_NOEXCEPT {}
+
+            JM_CB_CXX14_CONSTEXPR void reset_size() JM_CB_NOEXCEPT {}
+        };
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+        template<class T, class... Args>
+        JM_CB_CXX20_CONSTEXPR void cb_construct(T* p, Args&&... args)
+        {
+#if defined(JM_CIRCULAR_BUFFER_CXX20)
+            std::construct_at(p, std::forward<Args>(args)...);
+#else
+            ::new(static_cast<void*>(p)) T(std::forward<Args>(args)...);
+#endif
+        }
+
+#else
+
+        template<class T, class U>
+        void cb_construct(T* p, const U& value)
+        {
+            ::new(static_cast<void*>(p)) T(value);
+        }
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+        template<class T>
+        JM_CB_CXX20_CONSTEXPR void cb_destroy(T* p) JM_CB_NOEXCEPT
+        {
+#if defined(JM_CIRCULAR_BUFFER_CXX20)
+            std::destroy_at(p);
+#else
+            p->~T();
+#endif
+        }
+
+        // memcpy and friends can not be used in constant expressions
+        JM_CB_CONSTEXPR inline bool cb_is_constant_evaluated() JM_CB_NOEXCEPT
+        {
+#if defined(JM_CIRCULAR_BUFFER_CXX20)
+            return std::is_constant_evaluated();
+#else
+            return false;
+#endif
+        }
+
+        // the line of p is fetched without being kept around after it was used
+        inline void cb_prefetch(const void* p, bool write) JM_CB_NOEXCEPT
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            if(write)
+                __builtin_prefetch(p, 1, 0);
+            else
+                __builtin_prefetch(p, 0, 0);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+            (void)write;
+            _mm_prefetch(static_cast<const char*>(p), _MM_HINT_NTA);
+#else
+            (void)p;
+            (void)write;
+#endif
+        }
+
+        // memcpy that stores the aligned middle around the cache. The stores are
+        // weakly ordered, cb_stream_fence orders them before the stores that follow.
+        inline void cb_stream_copy(void* dest, const void* src, std::size_t bytes) JM_CB_NOEXCEPT
+        {
+#if defined(JM_CB_STREAM_SSE2)
+            char*       d    = static_cast<char*>(dest);
+            const char* s    = static_cast<const char*>(src);
+            std::size_t head = (16 - reinterpret_cast<std::size_t>(d) % 16) % 16;
+            if(head > bytes)
+                head = bytes;
+
+            std::memcpy(d, s, head);
+            d += head;
+            s += head;
+            bytes -= head;
+
+            for(; bytes >= 16; bytes -= 16, d += 16, s += 16)
+                _mm_stream_si128(reinterpret_cast<__m128i*>(d),
+                                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+
+            std::memcpy(d, s, bytes);
+#else
+            std::memcpy(dest, src, bytes);
+#endif
+        }
+
+        inline void cb_stream_fence() JM_CB_NOEXCEPT
+        {
+#if defined(JM_CB_STREAM_SSE2)
+            _mm_sfence();
+#endif
+        }
+
+        template<class T, bool = JM_CB_IS_TRIVIALLY_DESTRUCTIBLE(T)>
+        struct cb_destroyer {
+            JM_CB_CXX14_CONSTEXPR static void destroy_n(T*          first,
+                                                        std::size_t count) JM_CB_NOEXCEPT
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                    cb_destroy(first + i);
+            }
+        };
+
+        template<class T>
+        struct cb_destroyer<T, true /* trivially destructible */> {
+            JM_CB_CXX14_CONSTEXPR static void destroy_n(T*, std::size_t) JM_CB_NOEXCEPT {}
+        };
+
+        // copies into contiguous ranges,  lowered to memcpy when the source is contiguous
+        // and T trivially copyable
+        template<class T, bool = JM_CB_IS_TRIVIALLY_COPYABLE(T)>
+        struct cb_copier {
+            template<class InputIt>
+            static InputIt uninitialized_copy_n(InputIt first, std::size_t count, T* dest)
+            {
+                std::size_t i = 0;
+                try {
+                    for(; i < count; ++i, ++first)
+                        new(dest + i) T(*first);
+                }
+                catch(...) {
+                    for(; i != 0; --i)
+                        dest[i - 1].~T();
+                    throw;
+                }
+
+                return first;
+            }
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            static void uninitialized_move_n(T* first, std::size_t count, T* dest)
+            {
+                std::size_t i = 0;
+                try {
+                    for(; i < count; ++i)
+                        new(dest + i) T(std::move(first[i]));
+                }
+                catch(...) {
+                    for(; i != 0; --i)
+                        dest[i - 1].~T();
+                    throw;
+                }
+            }
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            template<class OutputIt>
+            static OutputIt copy_n(const T* first, std::size_t count, OutputIt dest)
+            {
+                return std::copy(first, first + count, dest);
+            }
+        };
+
+        template<class T>
+        struct cb_copier<T, true /* trivially copyable */> {
+            template<class InputIt>
+            static InputIt uninitialized_copy_n(InputIt first, std::size_t count, T* dest)
+            {
+                for(std::size_t i = 0; i < count; ++i, ++first)
+                    new(dest + i) T(*first);
+
+                return first;
+            }
+
+            static const T* uninitialized_copy_n(const T* first, std::size_t count, T* dest)
+            {
+                if(count != 0)
+                    std::memcpy(dest, first, count * sizeof(T));
+
+                return first + count;
+            }
+
+            static T* uninitialized_copy_n(T* first, std::size_t count, T* dest)
+            {
+                if(count != 0)
+                    std::memcpy(dest, first, count * sizeof(T));
+
+                return first + count;
+            }
+
+            static void uninitialized_move_n(T* first, std::size_t count, T* dest)
+            {
+                if(count != 0)
+                    std::memcpy(dest, first, count * sizeof(T));
+            }
+
+            template<class OutputIt>
+            static OutputIt copy_n(const T* first, std::size_t count, OutputIt dest)
+            {
+                return std::copy(first, first + count, dest);
+            }
+
+            static T* copy_n(const T* first, std::size_t count, T* dest)
+            {
+                if(count != 0)
+                    std::memmove(dest, first, count * sizeof(T));
+
+                return dest + count;
+            }
+        };
+
+        // copier of append_n, copies out of contiguous ranges use non temporal stores
+        // when the streaming policy asks for them and T is trivially copyable
+        template<class T, bool = false /* non temporal */>
+        struct cb_append_copier : cb_copier<T> {
+            static void fence() JM_CB_NOEXCEPT {}
+        };
+
+        template<class T>
+        struct cb_append_copier<T, true /* non temporal */> : cb_copier<T, true> {
+            using cb_copier<T, true>::uninitialized_copy_n;
+
+            static const T* uninitialized_copy_n(const T* first, std::size_t count, T* dest)
+            {
+                cb_stream_copy(dest, first, count * sizeof(T));
+                return first + count;
             }
+
+            static T* uninitialized_copy_n(T* first, std::size_t count, T* dest)
+            {
+                cb_stream_copy(dest, first, count * sizeof(T));
+                return first + count;
+            }
+
+            static void fence() JM_CB_NOEXCEPT { cb_stream_fence(); }
         };
 
 #if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
@@ -131,7 +677,7 @@ namespace jm {
                 : _value(std::move(value))
             {}
 
-            ~optional_storage() {}
+            JM_CB_CXX20_CONSTEXPR ~optional_storage() {}
         };
 
         template<class T>
@@ -178,50 +724,84 @@ namespace jm {
 
 #endif
 
-        template<class S, class TC, std::size_t N>
-        class cb_iterator {
-            template<class, class, std::size_t>
+        // the contiguous parts of an iterator range, [one, one + one_count) followed by
+        // [two, two + two_count)
+        template<class T>
+        struct cb_segments {
+            T*          one;
+            std::size_t one_count;
+            T*          two;
+            std::size_t two_count;
+        };
+
+        // Wrapper wraps physical slot indices, it is stored as a base to take no space
+        // when the capacity is known at compile time
+        template<class S, class TC, class Wrapper>
+        class cb_iterator : private Wrapper {
+            template<class, class, class>
             friend class cb_iterator;
 
             S*          _buf;
             std::size_t _pos;
             std::size_t _left_in_forward;
 
-            typedef detail::cb_index_wrapper<std::size_t, N> wrapper_t;
+            JM_CB_CONSTEXPR const Wrapper& wrapper() const JM_CB_NOEXCEPT { return *this; }
 
         public:
-            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef std::random_access_iterator_tag iterator_category;
             typedef TC                              value_type;
             typedef std::ptrdiff_t                  difference_type;
             typedef value_type*                     pointer;
             typedef value_type&                     reference;
 
+            /// splits [*this, last) into the at most two pointer ranges it consists of
+            JM_CB_CXX14_CONSTEXPR cb_segments<TC> segments(const cb_iterator& last) const
+                JM_CB_NOEXCEPT
+            {
+                const std::size_t count    = _left_in_forward - last._left_in_forward;
+                const std::size_t till_end = wrapper().capacity() - _pos;
+                const std::size_t first_count = (count < till_end) ? count : till_end;
+
+                cb_segments<TC> result = {JM_CB_NULLPTR, first_count, JM_CB_NULLPTR,
+                                          count - first_count};
+                if(count != 0) {
+                    result.one = JM_CB_ADDRESSOF(_buf[_pos]._value);
+                    result.two = JM_CB_ADDRESSOF(_buf[0]._value);
+                }
+
+                return result;
+            }
+
             explicit JM_CB_CONSTEXPR cb_iterator() JM_CB_NOEXCEPT : _buf(JM_CB_NULLPTR),
                                                                     _pos(0),
                                                                     _left_in_forward(0)
             {}
 
             explicit JM_CB_CONSTEXPR
-            cb_iterator(S*          buf,
-                        std::size_t pos,
-                        std::size_t left_in_forward) JM_CB_NOEXCEPT
-                : _buf(buf),
+            cb_iterator(S*             buf,
+                        std::size_t    pos,
+                        std::size_t    left_in_forward,
+                        const Wrapper& wrapper = Wrapper()) JM_CB_NOEXCEPT
+                : Wrapper(wrapper),
+                  _buf(buf),
                   _pos(pos),
                   _left_in_forward(left_in_forward)
             {}
 
             template<class TSnc, class Tnc>
             JM_CB_CONSTEXPR
-            cb_iterator(const cb_iterator<TSnc, Tnc, N>& other) JM_CB_NOEXCEPT
-                : _buf(other._buf),
+            cb_iterator(const cb_iterator<TSnc, Tnc, Wrapper>& other) JM_CB_NOEXCEPT
+                : Wrapper(other.wrapper()),
+                  _buf(other._buf),
                   _pos(other._pos),
                   _left_in_forward(other._left_in_forward)
             {}
 
             template<class TSnc, class Tnc>
             JM_CB_CXX14_CONSTEXPR cb_iterator&
-                                  operator=(const cb_iterator<TSnc, Tnc, N>& other) JM_CB_NOEXCEPT
+            operator=(const cb_iterator<TSnc, Tnc, Wrapper>& other) JM_CB_NOEXCEPT
             {
+                Wrapper::operator=(other.wrapper());
                 _buf             = other._buf;
                 _pos             = other._pos;
                 _left_in_forward = other._left_in_forward;
@@ -241,14 +821,14 @@ namespace jm {
 
             JM_CB_CXX14_CONSTEXPR cb_iterator& operator++() JM_CB_NOEXCEPT
             {
-                _pos = wrapper_t::increment(_pos);
+                _pos = wrapper().increment(_pos);
                 --_left_in_forward;
                 return *this;
             }
 
             JM_CB_CXX14_CONSTEXPR cb_iterator& operator--() JM_CB_NOEXCEPT
             {
-                _pos = wrapper_t::decrement(_pos);
+                _pos = wrapper().decrement(_pos);
                 ++_left_in_forward;
                 return *this;
             }
@@ -256,7 +836,7 @@ namespace jm {
             JM_CB_CXX14_CONSTEXPR cb_iterator operator++(int)JM_CB_NOEXCEPT
             {
                 cb_iterator temp = *this;
-                _pos             = wrapper_t::increment(_pos);
+                _pos             = wrapper().increment(_pos);
                 --_left_in_forward;
                 return temp;
             }
@@ -264,429 +844,2332 @@ namespace jm {
             JM_CB_CXX14_CONSTEXPR cb_iterator operator--(int)JM_CB_NOEXCEPT
             {
                 cb_iterator temp = *this;
-                _pos             = wrapper_t::decrement(_pos);
+                _pos             = wrapper().decrement(_pos);
                 ++_left_in_forward;
                 return temp;
             }
 
-            template<class Tx, class Ty>
-            JM_CB_CONSTEXPR bool
-            operator==(const cb_iterator<Tx, Ty, N>& lhs) const JM_CB_NOEXCEPT
+            JM_CB_CXX14_CONSTEXPR cb_iterator& operator+=(difference_type n) JM_CB_NOEXCEPT
             {
-                return lhs._left_in_forward == _left_in_forward && lhs._pos == _pos &&
-                       lhs._buf == _buf;
+                _pos = wrapper().advance(_pos, n);
+                _left_in_forward -= n;
+                return *this;
             }
 
-            template<typename Tx, typename Ty>
-            JM_CB_CONSTEXPR bool
-            operator!=(const cb_iterator<Tx, Ty, N>& lhs) const JM_CB_NOEXCEPT
+            JM_CB_CXX14_CONSTEXPR cb_iterator& operator-=(difference_type n) JM_CB_NOEXCEPT
             {
-                return !(operator==(lhs));
+                _pos = wrapper().advance(_pos, -n);
+                _left_in_forward += n;
+                return *this;
             }
-        };
 
-    } // namespace detail
+            JM_CB_CONSTEXPR cb_iterator operator+(difference_type n) const JM_CB_NOEXCEPT
+            {
+                return cb_iterator(
+                    _buf, wrapper().advance(_pos, n), _left_in_forward - n, wrapper());
+            }
+
+            JM_CB_CONSTEXPR cb_iterator operator-(difference_type n) const JM_CB_NOEXCEPT
+            {
+                return cb_iterator(
+                    _buf, wrapper().advance(_pos, -n), _left_in_forward + n, wrapper());
+            }
+
+            friend JM_CB_CONSTEXPR cb_iterator
+            operator+(difference_type n, const cb_iterator& it) JM_CB_NOEXCEPT
+            {
+                return it + n;
+            }
+
+            template<class Tx, class Ty>
+            JM_CB_CONSTEXPR difference_type
+            operator-(const cb_iterator<Tx, Ty, Wrapper>& rhs) const JM_CB_NOEXCEPT
+            {
+                return static_cast<difference_type>(rhs._left_in_forward) -
+                       static_cast<difference_type>(_left_in_forward);
+            }
+
+            JM_CB_CONSTEXPR reference operator[](difference_type n) const JM_CB_NOEXCEPT
+            {
+                return (_buf + wrapper().advance(_pos, n))->_value;
+            }
+
+            template<class Tx, class Ty>
+            JM_CB_CONSTEXPR bool
+            operator==(const cb_iterator<Tx, Ty, Wrapper>& lhs) const JM_CB_NOEXCEPT
+            {
+                return lhs._left_in_forward == _left_in_forward && lhs._pos == _pos &&
+                       lhs._buf == _buf;
+            }
+
+            template<typename Tx, typename Ty>
+            JM_CB_CONSTEXPR bool
+            operator!=(const cb_iterator<Tx, Ty, Wrapper>& lhs) const JM_CB_NOEXCEPT
+            {
+                return !(operator==(lhs));
+            }
+
+            template<class Tx, class Ty>
+            JM_CB_CONSTEXPR bool
+            operator<(const cb_iterator<Tx, Ty, Wrapper>& lhs) const JM_CB_NOEXCEPT
+            {
+                return _left_in_forward > lhs._left_in_forward;
+            }
+
+            template<class Tx, class Ty>
+            JM_CB_CONSTEXPR bool
+            operator>(const cb_iterator<Tx, Ty, Wrapper>& lhs) const JM_CB_NOEXCEPT
+            {
+                return _left_in_forward < lhs._left_in_forward;
+            }
+
+            template<class Tx, class Ty>
+            JM_CB_CONSTEXPR bool
+            operator<=(const cb_iterator<Tx, Ty, Wrapper>& lhs) const JM_CB_NOEXCEPT
+            {
+                return _left_in_forward >= lhs._left_in_forward;
+            }
+
+            template<class Tx, class Ty>
+            JM_CB_CONSTEXPR bool
+            operator>=(const cb_iterator<Tx, Ty, Wrapper>& lhs) const JM_CB_NOEXCEPT
+            {
+                return _left_in_forward <= lhs._left_in_forward;
+            }
+        };
+
+        // same as cb_index_wrapper but with the capacity only known at runtime
+        template<class size_type>
+        class cb_dynamic_index_wrapper {
+            size_type _capacity;
+
+        public:
+            explicit JM_CB_CONSTEXPR cb_dynamic_index_wrapper(size_type capacity = 0)
+                JM_CB_NOEXCEPT : _capacity(capacity)
+            {}
+
+            JM_CB_CONSTEXPR size_type capacity() const JM_CB_NOEXCEPT { return _capacity; }
+
+            // compares with >= so that a capacity of 0 keeps every index at 0
+            JM_CB_CONSTEXPR size_type increment(size_type value) const JM_CB_NOEXCEPT
+            {
+                return (value + 1 >= _capacity) ? 0 : value + 1;
+            }
+
+            JM_CB_CONSTEXPR size_type decrement(size_type value) const JM_CB_NOEXCEPT
+            {
+                return (value == 0) ? _capacity - 1 : value - 1;
+            }
+
+            // n must be in the range of [-capacity, capacity]
+            JM_CB_CONSTEXPR size_type advance(size_type      value,
+                                              std::ptrdiff_t n) const JM_CB_NOEXCEPT
+            {
+                return (n >= 0) ? ((value + static_cast<size_type>(n) >= _capacity)
+                                       ? value + static_cast<size_type>(n) - _capacity
+                                       : value + static_cast<size_type>(n))
+                                : ((value >= static_cast<size_type>(-n))
+                                       ? value - static_cast<size_type>(-n)
+                                       : value + _capacity - static_cast<size_type>(-n));
+            }
+
+            JM_CB_CONSTEXPR size_type index(size_type value) const JM_CB_NOEXCEPT
+            {
+                return value;
+            }
+        };
+
+        // storage policies of cb_base. They own the slots and provide the index
+        // wrappers that are used to walk them.
+        template<class T,
+                 std::size_t N,
+                 std::size_t Alignment = 0,
+                 class Streaming       = no_streaming,
+                 bool                  = (Alignment != 0)>
+        class cb_static_storage {
+        protected:
+            typedef Streaming                                              streaming_type;
+            typedef optional_storage<T>                                    storage_type;
+            typedef typename cb_select_index_wrapper<std::size_t, N>::type wrapper_type;
+            typedef cb_index_wrapper<std::size_t, N> iterator_wrapper_type;
+            typedef typename cb_index_type<N>::type  index_type;
+
+            storage_type _buffer[N];
+
+            JM_CB_CONSTEXPR cb_static_storage() : _buffer() {}
+
+            JM_CB_CONSTEXPR static wrapper_type wrapper() JM_CB_NOEXCEPT
+            {
+                return wrapper_type();
+            }
+
+            JM_CB_CONSTEXPR static iterator_wrapper_type iterator_wrapper() JM_CB_NOEXCEPT
+            {
+                return iterator_wrapper_type();
+            }
+
+            JM_CB_CONSTEXPR static std::size_t storage_capacity() JM_CB_NOEXCEPT
+            {
+                return N;
+            }
+        };
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+        // the slots start on an Alignment boundary and are followed by padding up to
+        // the next one, so the indices that cb_base places after them, and whatever
+        // follows the buffer, never share a cache line with the elements
+        template<class T, std::size_t N, std::size_t Alignment, class Streaming>
+        class alignas(Alignment) cb_static_storage<T, N, Alignment, Streaming, true /* aligned */>
+            : public cb_static_storage<T, N, 0, Streaming> {
+            static_assert((Alignment & (Alignment - 1)) == 0 &&
+                              Alignment >= alignof(optional_storage<T>),
+                          "Alignment has to be a power of two that is at least alignof(T)");
+
+            static const std::size_t bytes = N * sizeof(optional_storage<T>);
+
+            // explicit padding because tail padding of a base may be reused
+            char _padding[(bytes % Alignment == 0) ? 1 : Alignment - bytes % Alignment];
+
+        protected:
+            JM_CB_CONSTEXPR cb_static_storage() : cb_static_storage<T, N, 0, Streaming>(), _padding() {}
+        };
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+        // the slots are allocated through Allocator rebound to the slot type.
+        // elements are constructed in place, the allocator only provides the memory.
+        template<class T, class Allocator>
+        class cb_dynamic_storage {
+        protected:
+            typedef optional_storage<T> storage_type;
+            typedef typename std::allocator_traits<Allocator>::template rebind_alloc<
+                storage_type>
+                                                              allocator_type;
+            typedef std::allocator_traits<allocator_type>     alloc_traits;
+            typedef cb_dynamic_index_wrapper<std::size_t>     wrapper_type;
+            typedef wrapper_type                              iterator_wrapper_type;
+            typedef std::size_t                               index_type;
+            typedef no_streaming                              streaming_type;
+
+            static_assert(std::is_same<typename alloc_traits::pointer, storage_type*>::value,
+                          "the allocator has to use raw pointers");
+
+            allocator_type _allocator;
+            storage_type*  _buffer;
+            wrapper_type   _wrapper;
+
+            cb_dynamic_storage(std::size_t capacity, const allocator_type& alloc)
+                : _allocator(alloc), _buffer(allocate(capacity)), _wrapper(capacity)
+            {}
+
+            cb_dynamic_storage(const cb_dynamic_storage&) = delete;
+            cb_dynamic_storage& operator=(const cb_dynamic_storage&) = delete;
+
+            // the elements have to be destroyed by the owner
+            ~cb_dynamic_storage() { deallocate(_buffer, storage_capacity()); }
+
+            // buffers without capacity all share one slot that is never constructed into
+            // or written, so that the buffer pointer can always be indexed with 0. The
+            // pushes that overwrite when full return early without capacity.
+            static storage_type* empty_storage() JM_CB_NOEXCEPT
+            {
+                static storage_type slot;
+                return JM_CB_ADDRESSOF(slot);
+            }
+
+            storage_type* allocate(std::size_t capacity)
+            {
+                return (capacity == 0) ? empty_storage()
+                                       : alloc_traits::allocate(_allocator, capacity);
+            }
+
+            void deallocate(storage_type* buffer, std::size_t capacity) JM_CB_NOEXCEPT
+            {
+                if(capacity != 0)
+                    alloc_traits::deallocate(_allocator, buffer, capacity);
+            }
+
+            // releases the current slots, which must not hold any elements
+            void replace_storage(storage_type* buffer, std::size_t capacity) JM_CB_NOEXCEPT
+            {
+                deallocate(_buffer, storage_capacity());
+                _buffer  = buffer;
+                _wrapper = wrapper_type(capacity);
+            }
+
+            void swap_storage(cb_dynamic_storage& other) JM_CB_NOEXCEPT
+            {
+                using std::swap;
+                if(alloc_traits::propagate_on_container_swap::value)
+                    swap(_allocator, other._allocator);
+
+                swap(_buffer, other._buffer);
+                swap(_wrapper, other._wrapper);
+            }
+
+            const wrapper_type& wrapper() const JM_CB_NOEXCEPT { return _wrapper; }
+
+            const iterator_wrapper_type& iterator_wrapper() const JM_CB_NOEXCEPT
+            {
+                return _wrapper;
+            }
+
+            std::size_t storage_capacity() const JM_CB_NOEXCEPT { return _wrapper.capacity(); }
+        };
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+        // implements everything but the constructors of the circular buffers on top of
+        // a storage policy
+        template<class T, class Storage>
+        class cb_base
+            : protected Storage,
+              protected cb_indices<typename Storage::index_type,
+                                   cb_is_monotonic<typename Storage::wrapper_type>::value>,
+              public cb_statistics_recorder {
+        protected:
+            typedef typename Storage::storage_type storage_type;
+            typedef cb_indices<typename Storage::index_type,
+                               cb_is_monotonic<typename Storage::wrapper_type>::value>
+                indices_type;
+
+            using indices_type::_head;
+            using indices_type::_tail;
+            using indices_type::grow_size;
+            using indices_type::shrink_size;
+            using indices_type::reset_size;
+
+        public:
+            typedef T                                   value_type;
+            typedef std::size_t                         size_type;
+            typedef std::ptrdiff_t                      difference_type;
+            typedef T&                                  reference;
+            typedef const T&                            const_reference;
+            typedef T*                                  pointer;
+            typedef const T*                            const_pointer;
+            typedef detail::cb_iterator<storage_type,
+                                        T,
+                                        typename Storage::iterator_wrapper_type>
+                iterator;
+            typedef detail::cb_iterator<const storage_type,
+                                        const T,
+                                        typename Storage::iterator_wrapper_type>
+                                                          const_iterator;
+            typedef std::reverse_iterator<iterator>       reverse_iterator;
+            typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+            typedef std::pair<pointer, size_type>         array_range;
+            typedef std::pair<const_pointer, size_type>   const_array_range;
+
+        protected:
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+            static_assert(sizeof(storage_type) == sizeof(T),
+                          "storage has to be layout compatible with an array of T");
+#endif
+
+            JM_CB_CONSTEXPR size_type begin_index() const JM_CB_NOEXCEPT
+            {
+                return this->wrapper().index(_head);
+            }
+
+            JM_CB_CONSTEXPR size_type end_index() const JM_CB_NOEXCEPT
+            {
+                return this->wrapper().index(this->wrapper().increment(_tail));
+            }
+
+            JM_CB_CXX14_CONSTEXPR storage_type& slot(size_type idx) JM_CB_NOEXCEPT
+            {
+                return this->_buffer[this->wrapper().index(idx)];
+            }
+
+            JM_CB_CONSTEXPR const storage_type& slot(size_type idx) const JM_CB_NOEXCEPT
+            {
+                return this->_buffer[this->wrapper().index(idx)];
+            }
+
+            // number of slots that can be walked from idx before having to wrap around
+            JM_CB_CONSTEXPR size_type contiguous(size_type idx, size_type count) const JM_CB_NOEXCEPT
+            {
+                return (count < capacity() - idx) ? count : capacity() - idx;
+            }
+
+            // prefetches the slot the streaming policy's distance after idx, the
+            // distance is smaller than the capacity
+            JM_CB_CXX14_CONSTEXPR void prefetch_after(size_type idx, bool write) const JM_CB_NOEXCEPT
+            {
+                typedef typename Storage::streaming_type streaming_type;
+
+                if(streaming_type::prefetch_distance != 0 && !detail::cb_is_constant_evaluated())
+                    detail::cb_prefetch(
+                        JM_CB_ADDRESSOF(slot(this->wrapper().advance(
+                            idx, static_cast<difference_type>(streaming_type::prefetch_distance)))),
+                        write);
+            }
+
+            JM_CB_CXX20_CONSTEXPR void destroy(size_type idx) JM_CB_NOEXCEPT
+            {
+                detail::cb_destroy(JM_CB_ADDRESSOF(slot(idx)._value));
+            }
+
+            // destroys count elements starting at the physical index idx.
+            // does nothing for trivially destructible types.
+            JM_CB_CXX14_CONSTEXPR void destroy_n(size_type idx, size_type count) JM_CB_NOEXCEPT
+            {
+                typedef detail::cb_destroyer<T> destroyer_t;
+
+                if(detail::cb_is_constant_evaluated()) {
+                    for(; count != 0; --count, idx = this->wrapper().increment(idx))
+                        destroy(idx);
+                    return;
+                }
+
+                const size_type first_count = contiguous(idx, count);
+                destroyer_t::destroy_n(JM_CB_ADDRESSOF(this->_buffer[idx]._value), first_count);
+                destroyer_t::destroy_n(JM_CB_ADDRESSOF(this->_buffer[0]._value), count - first_count);
+            }
+
+            // constructs count elements into the free slots while evicting from the front
+            // if necessary. At most capacity() elements are copied and the rest of the input
+            // skipped, which is recorded as overwritten like pushing them one at a time would.
+            template<class ForwardIt>
+            JM_CB_CXX20_CONSTEXPR void append_n(ForwardIt first, size_type count)
+            {
+                typedef detail::cb_append_copier<T,
+                                                 Storage::streaming_type::non_temporal &&
+                                                     JM_CB_IS_TRIVIALLY_COPYABLE(T)>
+                    copier_t;
+
+                if(count > capacity()) {
+                    const size_type skipped = count - capacity();
+                    std::advance(first, static_cast<difference_type>(skipped));
+                    count = capacity();
+
+                    // pushes into a buffer without capacity are not recorded at all
+                    if(count != 0)
+                        this->record_overwrite(skipped);
+                }
+
+                // slots can only be walked one at a time in constant expressions
+                if(detail::cb_is_constant_evaluated()) {
+                    for(; count != 0; --count, ++first)
+                        push_back(*first);
+                    return;
+                }
+
+                const size_type evicted = (size() + count > capacity())
+                                              ? size() + count - capacity()
+                                              : 0;
+                drop_front(evicted);
+
+                const size_type first_count = contiguous(end_index(), count);
+                first = copier_t::uninitialized_copy_n(
+                    first, first_count, JM_CB_ADDRESSOF(this->_buffer[end_index()]._value));
+                grow_back(first_count);
+
+                copier_t::uninitialized_copy_n(
+                    first, count - first_count, JM_CB_ADDRESSOF(this->_buffer[0]._value));
+                grow_back(count - first_count);
+                copier_t::fence();
+
+                this->record_overwrite(evicted);
+                this->record_push(count - evicted, size());
+            }
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            template<class InputIt>
+            JM_CB_CXX20_CONSTEXPR void
+            push_back_range(InputIt first, InputIt last, std::input_iterator_tag)
+            {
+                for(; first != last; ++first)
+                    push_back(*first);
+            }
+
+            template<class ForwardIt>
+            JM_CB_CXX20_CONSTEXPR void
+            push_back_range(ForwardIt first, ForwardIt last, std::forward_iterator_tag)
+            {
+                append_n(first, static_cast<size_type>(std::distance(first, last)));
+            }
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            // copies the elements of other into the same slots and takes over its indices.
+            // this has to be empty and have the same capacity as other.
+            JM_CB_CXX20_CONSTEXPR void copy_buffer(const cb_base& other)
+            {
+                typedef detail::cb_copier<T> copier_t;
+
+                if(detail::cb_is_constant_evaluated()) {
+                    size_type idx = other.begin_index();
+                    for(size_type i = 0; i < other.size(); ++i, idx = this->wrapper().increment(idx))
+                        detail::cb_construct(JM_CB_ADDRESSOF(slot(idx)._value), other.slot(idx)._value);
+
+                    indices_type::operator=(other);
+                    return;
+                }
+
+                const const_array_range one   = other.array_one();
+                const const_array_range two   = other.array_two();
+                T* const                first = JM_CB_ADDRESSOF(this->_buffer[other.begin_index()]._value);
+
+                copier_t::uninitialized_copy_n(one.first, one.second, first);
+                try {
+                    copier_t::uninitialized_copy_n(
+                        two.first, two.second, JM_CB_ADDRESSOF(this->_buffer[0]._value));
+                }
+                catch(...) {
+                    detail::cb_destroyer<T>::destroy_n(first, one.second);
+                    throw;
+                }
+
+                indices_type::operator=(other);
+            }
+
+            // assigns over the elements that are already constructed and only constructs
+            // or destroys the difference. the capacity has to be the same as of other.
+            JM_CB_CXX20_CONSTEXPR void assign_buffer(const cb_base& other)
+            {
+                if(JM_CB_IS_TRIVIALLY_COPYABLE(T)) {
+                    clear();
+                    copy_buffer(other);
+                    return;
+                }
+
+                const size_type common = (size() < other.size()) ? size() : other.size();
+                const_iterator  src    = other.begin();
+                iterator        dst    = begin();
+                for(size_type i = 0; i < common; ++i, ++src, ++dst)
+                    *dst = *src;
+
+                if(size() > common)
+                    pop_back(size() - common);
+                else
+                    append_n(src, other.size() - common);
+            }
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            // same as copy_buffer but moves the elements. other keeps its moved from elements.
+            JM_CB_CXX20_CONSTEXPR void move_buffer(cb_base&& other)
+            {
+                typedef detail::cb_copier<T> copier_t;
+
+                if(detail::cb_is_constant_evaluated()) {
+                    size_type idx = other.begin_index();
+                    for(size_type i = 0; i < other.size(); ++i, idx = this->wrapper().increment(idx))
+                        detail::cb_construct(JM_CB_ADDRESSOF(slot(idx)._value),
+                                             std::move(other.slot(idx)._value));
+
+                    indices_type::operator=(other);
+                    return;
+                }
+
+                const array_range one   = other.array_one();
+                const array_range two   = other.array_two();
+                T* const          first = JM_CB_ADDRESSOF(this->_buffer[other.begin_index()]._value);
+
+                copier_t::uninitialized_move_n(one.first, one.second, first);
+                try {
+                    copier_t::uninitialized_move_n(
+                        two.first, two.second, JM_CB_ADDRESSOF(this->_buffer[0]._value));
+                }
+                catch(...) {
+                    detail::cb_destroyer<T>::destroy_n(first, one.second);
+                    throw;
+                }
+
+                indices_type::operator=(other);
+            }
+
+            JM_CB_CXX20_CONSTEXPR void assign_buffer(cb_base&& other)
+            {
+                if(JM_CB_IS_TRIVIALLY_COPYABLE(T)) {
+                    clear();
+                    move_buffer(std::move(other));
+                    return;
+                }
+
+                const size_type common = (size() < other.size()) ? size() : other.size();
+                iterator        src    = other.begin();
+                iterator        dst    = begin();
+                for(size_type i = 0; i < common; ++i, ++src, ++dst)
+                    *dst = std::move(*src);
+
+                if(size() > common)
+                    pop_back(size() - common);
+                else
+                    append_n(std::make_move_iterator(src), other.size() - common);
+            }
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            JM_CB_CXX14_CONSTEXPR void reset_indices() JM_CB_NOEXCEPT
+            {
+                _head = this->wrapper().increment(0);
+                _tail = 0;
+            }
+
+            JM_CB_CONSTEXPR cb_base()
+                : Storage(), indices_type(Storage::wrapper().increment(0))
+            {}
+
+            template<class Allocator>
+            cb_base(size_type capacity, const Allocator& alloc)
+                : Storage(capacity, alloc), indices_type(Storage::wrapper().increment(0))
+            {}
+
+            JM_CB_CXX14_CONSTEXPR void swap_indices(cb_base& other) JM_CB_NOEXCEPT
+            {
+                std::swap(static_cast<indices_type&>(*this), static_cast<indices_type&>(other));
+                std::swap(static_cast<cb_statistics_recorder&>(*this),
+                          static_cast<cb_statistics_recorder&>(other));
+            }
+
+            // pop_front and commit_back without being recorded
+            JM_CB_CXX14_CONSTEXPR void drop_front(size_type count) JM_CB_NOEXCEPT
+            {
+                destroy_n(begin_index(), count);
+                _head = this->wrapper().advance(_head, static_cast<difference_type>(count));
+                shrink_size(count);
+            }
+
+            JM_CB_CXX14_CONSTEXPR void grow_back(size_type count) JM_CB_NOEXCEPT
+            {
+                _tail = this->wrapper().advance(_tail, static_cast<difference_type>(count));
+                grow_size(count);
+            }
+
+        public:
+#if defined(JM_CIRCULAR_BUFFER_STATISTICS)
+            /// statistics
+            /// restarts counting, the peak size starts at the current size
+            JM_CB_CXX14_CONSTEXPR void reset_statistics() JM_CB_NOEXCEPT
+            {
+                cb_statistics_recorder::reset_statistics(size());
+            }
+#endif
+
+            /// capacity
+            JM_CB_CONSTEXPR bool empty() const JM_CB_NOEXCEPT { return size() == 0; }
+
+            JM_CB_CONSTEXPR bool full() const JM_CB_NOEXCEPT { return size() == capacity(); }
+
+            JM_CB_CONSTEXPR size_type size() const JM_CB_NOEXCEPT
+            {
+                return this->stored_size();
+            }
+
+            JM_CB_CONSTEXPR size_type max_size() const JM_CB_NOEXCEPT { return capacity(); }
+
+            JM_CB_CONSTEXPR size_type capacity() const JM_CB_NOEXCEPT
+            {
+                return this->storage_capacity();
+            }
+
+            /// element access
+            JM_CB_CXX14_CONSTEXPR reference front() JM_CB_NOEXCEPT
+            {
+                return slot(_head)._value;
+            }
+
+            JM_CB_CONSTEXPR const_reference front() const JM_CB_NOEXCEPT
+            {
+                return slot(_head)._value;
+            }
+
+            JM_CB_CXX14_CONSTEXPR reference back() JM_CB_NOEXCEPT
+            {
+                return slot(_tail)._value;
+            }
+
+            JM_CB_CONSTEXPR const_reference back() const JM_CB_NOEXCEPT
+            {
+                return slot(_tail)._value;
+            }
+
+            JM_CB_CXX14_CONSTEXPR reference operator[](size_type pos) JM_CB_NOEXCEPT
+            {
+                return slot(this->wrapper().advance(_head, static_cast<difference_type>(pos)))
+                    ._value;
+            }
+
+            JM_CB_CONSTEXPR const_reference operator[](size_type pos) const JM_CB_NOEXCEPT
+            {
+                return slot(this->wrapper().advance(_head, static_cast<difference_type>(pos)))
+                    ._value;
+            }
+
+            JM_CB_CXX14_CONSTEXPR reference at(size_type pos)
+            {
+                if(JM_CB_UNLIKELY(pos >= size()))
+                    throw std::out_of_range(
+                        "circular_buffer<T, N>::at(size_type pos) pos >= size()");
+
+                return (*this)[pos];
+            }
+
+            JM_CB_CONSTEXPR const_reference at(size_type pos) const
+            {
+                return JM_CB_LIKELY(pos < size())
+                           ? (*this)[pos]
+                           : throw std::out_of_range(
+                                 "circular_buffer<T, N>::at(size_type pos) pos >= size()");
+            }
+
+            JM_CB_CXX14_CONSTEXPR pointer data() JM_CB_NOEXCEPT
+            {
+                return JM_CB_ADDRESSOF(this->_buffer[0]._value);
+            }
+
+            JM_CB_CONSTEXPR const_pointer data() const JM_CB_NOEXCEPT
+            {
+                return JM_CB_ADDRESSOF(this->_buffer[0]._value);
+            }
+
+            /// contiguous segments
+            /// the elements in logical order are array_one() followed by array_two()
+            JM_CB_CXX14_CONSTEXPR array_range array_one() JM_CB_NOEXCEPT
+            {
+                return array_range(JM_CB_ADDRESSOF(this->_buffer[begin_index()]._value),
+                                   contiguous(begin_index(), size()));
+            }
+
+            JM_CB_CONSTEXPR const_array_range array_one() const JM_CB_NOEXCEPT
+            {
+                return const_array_range(JM_CB_ADDRESSOF(this->_buffer[begin_index()]._value),
+                                         contiguous(begin_index(), size()));
+            }
+
+            JM_CB_CXX14_CONSTEXPR array_range array_two() JM_CB_NOEXCEPT
+            {
+                return array_range(JM_CB_ADDRESSOF(this->_buffer[0]._value),
+                                   size() - contiguous(begin_index(), size()));
+            }
+
+            JM_CB_CONSTEXPR const_array_range array_two() const JM_CB_NOEXCEPT
+            {
+                return const_array_range(JM_CB_ADDRESSOF(this->_buffer[0]._value),
+                                         size() - contiguous(begin_index(), size()));
+            }
+
+            /// the unused slots following back() are free_array_one() followed by
+            /// free_array_two(). They hold no objects, see commit_back.
+            JM_CB_CXX14_CONSTEXPR array_range free_array_one() JM_CB_NOEXCEPT
+            {
+                return array_range(JM_CB_ADDRESSOF(this->_buffer[end_index()]._value),
+                                   contiguous(end_index(), capacity() - size()));
+            }
+
+            JM_CB_CXX14_CONSTEXPR array_range free_array_two() JM_CB_NOEXCEPT
+            {
+                return array_range(JM_CB_ADDRESSOF(this->_buffer[0]._value),
+                                   capacity() - size() - contiguous(end_index(), capacity() - size()));
+            }
+
+            /// calls f(first, last) with the pointer ranges of array_one() and array_two()
+            /// that are not empty, in logical order. returns f like std::for_each.
+            template<class F>
+            F for_each_segment(F f)
+            {
+                const array_range one = array_one();
+                const array_range two = array_two();
+                if(one.second != 0)
+                    f(one.first, one.first + one.second);
+                if(two.second != 0)
+                    f(two.first, two.first + two.second);
+
+                return f;
+            }
+
+            template<class F>
+            F for_each_segment(F f) const
+            {
+                const const_array_range one = array_one();
+                const const_array_range two = array_two();
+                if(one.second != 0)
+                    f(one.first, one.first + one.second);
+                if(two.second != 0)
+                    f(two.first, two.first + two.second);
+
+                return f;
+            }
+
+            /// modifiers
+            /// pushes into a buffer without capacity, which is always full, do nothing
+            JM_CB_CXX20_CONSTEXPR void push_back(const value_type& value)
+            {
+                // when full the next slot is the front, which gets overwritten
+                const size_type new_tail = this->wrapper().increment(_tail);
+                prefetch_after(new_tail, true);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return;
+                    slot(new_tail)._value = value;
+                    _head                 = this->wrapper().increment(_head);
+                    this->record_overwrite(1);
+                }
+                else {
+                    detail::cb_construct(JM_CB_ADDRESSOF(slot(new_tail)._value), value);
+                    this->record_push(1, size() + 1);
+                    grow_size(1);
+                }
+
+                _tail = new_tail;
+            }
+
+            JM_CB_CXX20_CONSTEXPR void push_front(const value_type& value)
+            {
+                // when full the previous slot is the back, which gets overwritten
+                const size_type new_head = this->wrapper().decrement(_head);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return;
+                    slot(new_head)._value = value;
+                    _tail                 = this->wrapper().decrement(_tail);
+                    this->record_overwrite(1);
+                }
+                else {
+                    detail::cb_construct(JM_CB_ADDRESSOF(slot(new_head)._value), value);
+                    this->record_push(1, size() + 1);
+                    grow_size(1);
+                }
+
+                _head = new_head;
+            }
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            JM_CB_CXX20_CONSTEXPR void push_back(value_type&& value)
+            {
+                // when full the next slot is the front, which gets overwritten
+                const size_type new_tail = this->wrapper().increment(_tail);
+                prefetch_after(new_tail, true);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return;
+                    slot(new_tail)._value = detail::move_if_noexcept_assign(value);
+                    _head                 = this->wrapper().increment(_head);
+                    this->record_overwrite(1);
+                }
+                else {
+                    detail::cb_construct(JM_CB_ADDRESSOF(slot(new_tail)._value),
+                                         std::move_if_noexcept(value));
+                    this->record_push(1, size() + 1);
+                    grow_size(1);
+                }
+
+                _tail = new_tail;
+            }
+
+            JM_CB_CXX20_CONSTEXPR void push_front(value_type&& value)
+            {
+                // when full the previous slot is the back, which gets overwritten
+                const size_type new_head = this->wrapper().decrement(_head);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return;
+                    slot(new_head)._value = detail::move_if_noexcept_assign(value);
+                    _tail                 = this->wrapper().decrement(_tail);
+                    this->record_overwrite(1);
+                }
+                else {
+                    detail::cb_construct(JM_CB_ADDRESSOF(slot(new_head)._value),
+                                         std::move_if_noexcept(value));
+                    this->record_push(1, size() + 1);
+                    grow_size(1);
+                }
+
+                _head = new_head;
+            }
+
+            template<typename... Args>
+            JM_CB_CXX20_CONSTEXPR void emplace_back(Args&&... args)
+            {
+                const size_type new_tail = this->wrapper().increment(_tail);
+                prefetch_after(new_tail, true);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return;
+                    destroy(new_tail);
+                    _head = this->wrapper().increment(_head);
+                    shrink_size(1);
+                    this->record_overwrite(1);
+                }
+                else
+                    this->record_push(1, size() + 1);
+
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_tail)._value),
+                                     std::forward<Args>(args)...);
+                _tail = new_tail;
+                grow_size(1);
+            }
+
+            template<typename... Args>
+            JM_CB_CXX20_CONSTEXPR void emplace_front(Args&&... args)
+            {
+                const size_type new_head = this->wrapper().decrement(_head);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return;
+                    destroy(new_head);
+                    _tail = this->wrapper().decrement(_tail);
+                    shrink_size(1);
+                    this->record_overwrite(1);
+                }
+                else
+                    this->record_push(1, size() + 1);
+
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_head)._value),
+                                     std::forward<Args>(args)...);
+                _head = new_head;
+                grow_size(1);
+            }
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            /// pushes only if there is space left instead of overwriting.
+            /// returns whether value was pushed.
+            JM_CB_CXX20_CONSTEXPR bool try_push_back(const value_type& value)
+            {
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    this->record_rejected();
+                    return false;
+                }
+
+                const size_type new_tail = this->wrapper().increment(_tail);
+                prefetch_after(new_tail, true);
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_tail)._value), value);
+                grow_size(1);
+                _tail = new_tail;
+                this->record_push(1, size());
+                return true;
+            }
+
+            JM_CB_CXX20_CONSTEXPR bool try_push_front(const value_type& value)
+            {
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    this->record_rejected();
+                    return false;
+                }
+
+                const size_type new_head = this->wrapper().decrement(_head);
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_head)._value), value);
+                grow_size(1);
+                _head = new_head;
+                this->record_push(1, size());
+                return true;
+            }
+
+            /// pushes value and, if the buffer was full, moves the element it replaced
+            /// into evicted so that it can be reused. returns whether an element was evicted.
+            JM_CB_CXX20_CONSTEXPR bool
+            push_back_overwrite(const value_type& value, value_type& evicted)
+            {
+                const size_type new_tail = this->wrapper().increment(_tail);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return false;
+                    evicted = JM_CB_MOVE(slot(new_tail)._value);
+                    slot(new_tail)._value = value;
+                    _head                 = this->wrapper().increment(_head);
+                    _tail                 = new_tail;
+                    this->record_overwrite(1);
+                    return true;
+                }
+
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_tail)._value), value);
+                grow_size(1);
+                _tail = new_tail;
+                this->record_push(1, size());
+                return false;
+            }
+
+            JM_CB_CXX20_CONSTEXPR bool
+            push_front_overwrite(const value_type& value, value_type& evicted)
+            {
+                const size_type new_head = this->wrapper().decrement(_head);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return false;
+                    evicted = JM_CB_MOVE(slot(new_head)._value);
+                    slot(new_head)._value = value;
+                    _tail                 = this->wrapper().decrement(_tail);
+                    _head                 = new_head;
+                    this->record_overwrite(1);
+                    return true;
+                }
+
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_head)._value), value);
+                grow_size(1);
+                _head = new_head;
+                this->record_push(1, size());
+                return false;
+            }
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            JM_CB_CXX20_CONSTEXPR bool try_push_back(value_type&& value)
+            {
+                return try_emplace_back(std::move(value));
+            }
+
+            JM_CB_CXX20_CONSTEXPR bool try_push_front(value_type&& value)
+            {
+                return try_emplace_front(std::move(value));
+            }
+
+            template<typename... Args>
+            JM_CB_CXX20_CONSTEXPR bool try_emplace_back(Args&&... args)
+            {
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    this->record_rejected();
+                    return false;
+                }
+
+                const size_type new_tail = this->wrapper().increment(_tail);
+                prefetch_after(new_tail, true);
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_tail)._value),
+                                     std::forward<Args>(args)...);
+                grow_size(1);
+                _tail = new_tail;
+                this->record_push(1, size());
+                return true;
+            }
+
+            template<typename... Args>
+            JM_CB_CXX20_CONSTEXPR bool try_emplace_front(Args&&... args)
+            {
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    this->record_rejected();
+                    return false;
+                }
+
+                const size_type new_head = this->wrapper().decrement(_head);
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_head)._value),
+                                     std::forward<Args>(args)...);
+                grow_size(1);
+                _head = new_head;
+                this->record_push(1, size());
+                return true;
+            }
+
+            JM_CB_CXX20_CONSTEXPR bool push_back_overwrite(value_type&& value, value_type& evicted)
+            {
+                const size_type new_tail = this->wrapper().increment(_tail);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return false;
+                    evicted               = std::move(slot(new_tail)._value);
+                    slot(new_tail)._value = std::move(value);
+                    _head                 = this->wrapper().increment(_head);
+                    _tail                 = new_tail;
+                    this->record_overwrite(1);
+                    return true;
+                }
+
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_tail)._value), std::move(value));
+                grow_size(1);
+                _tail = new_tail;
+                this->record_push(1, size());
+                return false;
+            }
+
+            JM_CB_CXX20_CONSTEXPR bool push_front_overwrite(value_type&& value, value_type& evicted)
+            {
+                const size_type new_head = this->wrapper().decrement(_head);
+                if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                    if(JM_CB_UNLIKELY(capacity() == 0))
+                        return false;
+                    evicted               = std::move(slot(new_head)._value);
+                    slot(new_head)._value = std::move(value);
+                    _tail                 = this->wrapper().decrement(_tail);
+                    _head                 = new_head;
+                    this->record_overwrite(1);
+                    return true;
+                }
+
+                detail::cb_construct(JM_CB_ADDRESSOF(slot(new_head)._value), std::move(value));
+                grow_size(1);
+                _head = new_head;
+                this->record_push(1, size());
+                return false;
+            }
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            /// appends count elements from src, overwriting the front if there is not
+            /// enough space. Only the last capacity() elements are kept if count exceeds it.
+            JM_CB_CXX20_CONSTEXPR void
+            append(const_pointer src, size_type count) { append_n(src, count); }
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            template<class InputIt,
+                     class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+            JM_CB_CXX20_CONSTEXPR void push_back(InputIt first, InputIt last)
+            {
+                push_back_range(
+                    first, last, typename std::iterator_traits<InputIt>::iterator_category());
+            }
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            JM_CB_CXX14_CONSTEXPR void pop_back() JM_CB_NOEXCEPT
+            {
+                const size_type old_tail = _tail;
+                shrink_size(1);
+                _tail = this->wrapper().decrement(_tail);
+                destroy(old_tail);
+                this->record_pop(1);
+            }
+
+            JM_CB_CXX14_CONSTEXPR void pop_front() JM_CB_NOEXCEPT
+            {
+                const size_type old_head = _head;
+                shrink_size(1);
+                _head = this->wrapper().increment(_head);
+                destroy(old_head);
+                prefetch_after(old_head, false);
+                this->record_pop(1);
+            }
+
+            /// removes count elements from the front, count must not exceed size()
+            JM_CB_CXX14_CONSTEXPR void pop_front(size_type count) JM_CB_NOEXCEPT
+            {
+                drop_front(count);
+                prefetch_after(_head, false);
+                this->record_pop(count);
+            }
+
+            /// removes count elements from the back, count must not exceed size()
+            JM_CB_CXX14_CONSTEXPR void pop_back(size_type count) JM_CB_NOEXCEPT
+            {
+                const difference_type n = static_cast<difference_type>(count);
+                destroy_n(this->wrapper().index(this->wrapper().advance(_tail, 1 - n)), count);
+                _tail = this->wrapper().advance(_tail, -n);
+                shrink_size(count);
+                this->record_pop(count);
+            }
+
+            /// copies up to count elements from the front into dest without removing them.
+            /// returns the number of elements that were copied.
+            template<class OutputIt>
+            JM_CB_CXX20_CONSTEXPR size_type copy_out(OutputIt dest, size_type count) const
+            {
+                typedef detail::cb_copier<T> copier_t;
+
+                if(count > size())
+                    count = size();
+
+                if(detail::cb_is_constant_evaluated()) {
+                    const_iterator it = begin();
+                    for(size_type i = 0; i < count; ++i, ++it, ++dest)
+                        *dest = *it;
+                    return count;
+                }
+
+                const size_type first_count = contiguous(begin_index(), count);
+                dest = copier_t::copy_n(
+                    JM_CB_ADDRESSOF(this->_buffer[begin_index()]._value), first_count, dest);
+                copier_t::copy_n(JM_CB_ADDRESSOF(this->_buffer[0]._value), count - first_count, dest);
+                return count;
+            }
+
+            /// appends the first count free slots to the back of the buffer.
+            /// the caller must have constructed the objects in them already, for example by
+            /// writing into free_array_one() and free_array_two() for trivial types.
+            JM_CB_CXX14_CONSTEXPR void commit_back(size_type count) JM_CB_NOEXCEPT
+            {
+                grow_back(count);
+                this->record_push(count, size());
+            }
+
+            JM_CB_CXX14_CONSTEXPR void clear() JM_CB_NOEXCEPT
+            {
+                this->record_pop(size());
+                destroy_n(begin_index(), size());
+                reset_size();
+                reset_indices();
+            }
+
+            /// iterators
+            JM_CB_CXX14_CONSTEXPR iterator begin() JM_CB_NOEXCEPT
+            {
+                if(empty())
+                    return end();
+                return iterator(this->_buffer, begin_index(), size(), this->iterator_wrapper());
+            }
+
+            JM_CB_CXX14_CONSTEXPR const_iterator begin() const JM_CB_NOEXCEPT
+            {
+                if(empty())
+                    return end();
+                return const_iterator(this->_buffer, begin_index(), size(), this->iterator_wrapper());
+            }
+
+            JM_CB_CXX14_CONSTEXPR const_iterator cbegin() const JM_CB_NOEXCEPT
+            {
+                if(empty())
+                    return cend();
+                return const_iterator(this->_buffer, begin_index(), size(), this->iterator_wrapper());
+            }
+
+            JM_CB_CXX14_CONSTEXPR reverse_iterator rbegin() JM_CB_NOEXCEPT
+            {
+                if(empty())
+                    return rend();
+                return reverse_iterator(iterator(this->_buffer, begin_index(), size(), this->iterator_wrapper()));
+            }
+
+            JM_CB_CXX14_CONSTEXPR const_reverse_iterator rbegin() const JM_CB_NOEXCEPT
+            {
+                if(empty())
+                    return rend();
+                return const_reverse_iterator(const_iterator(this->_buffer, begin_index(), size(), this->iterator_wrapper()));
+            }
+
+            JM_CB_CXX14_CONSTEXPR const_reverse_iterator crbegin() const JM_CB_NOEXCEPT
+            {
+                if(empty())
+                    return crend();
+                return const_reverse_iterator(const_iterator(this->_buffer, begin_index(), size(), this->iterator_wrapper()));
+            }
+
+            JM_CB_CXX14_CONSTEXPR iterator end() JM_CB_NOEXCEPT
+            {
+                return iterator(this->_buffer, end_index(), 0, this->iterator_wrapper());
+            }
+
+            JM_CB_CXX14_CONSTEXPR const_iterator end() const JM_CB_NOEXCEPT
+            {
+                return const_iterator(this->_buffer, end_index(), 0, this->iterator_wrapper());
+            }
+
+            JM_CB_CXX14_CONSTEXPR const_iterator cend() const JM_CB_NOEXCEPT
+            {
+                return const_iterator(this->_buffer, end_index(), 0, this->iterator_wrapper());
+            }
+
+            JM_CB_CXX14_CONSTEXPR reverse_iterator rend() JM_CB_NOEXCEPT
+            {
+                return reverse_iterator(iterator(this->_buffer, end_index(), 0, this->iterator_wrapper()));
+            }
+
+            JM_CB_CXX14_CONSTEXPR const_reverse_iterator rend() const JM_CB_NOEXCEPT
+            {
+                return const_reverse_iterator(const_iterator(this->_buffer, end_index(), 0, this->iterator_wrapper()));
+            }
+
+            JM_CB_CXX14_CONSTEXPR const_reverse_iterator crend() const JM_CB_NOEXCEPT
+            {
+                return const_reverse_iterator(const_iterator(this->_buffer, end_index(), 0, this->iterator_wrapper()));
+            }
+        };
+
+        // gives cb_base the special members of a container that owns its elements.
+        // Trivially copyable elements leave them implicit, so that the buffer is
+        // trivially copyable too and a copy is the copy of its slots and indices.
+        template<class T, class Storage, bool = JM_CB_IS_TRIVIALLY_COPYABLE(T)>
+        class cb_element_owner : public cb_base<T, Storage> {
+            typedef cb_base<T, Storage> base_type;
+
+        protected:
+            JM_CB_CONSTEXPR cb_element_owner() : base_type() {}
+
+            template<class Allocator>
+            cb_element_owner(typename base_type::size_type capacity, const Allocator& alloc)
+                : base_type(capacity, alloc)
+            {}
+
+            JM_CB_CXX20_CONSTEXPR cb_element_owner(const cb_element_owner& other)
+                : base_type()
+            {
+                this->copy_buffer(other);
+            }
+
+            JM_CB_CXX20_CONSTEXPR cb_element_owner& operator=(const cb_element_owner& other)
+            {
+                if(this != &other)
+                    this->assign_buffer(other);
+
+                return *this;
+            }
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            JM_CB_CXX20_CONSTEXPR cb_element_owner(cb_element_owner&& other) : base_type()
+            {
+                this->move_buffer(std::move(other));
+            }
+
+            JM_CB_CXX20_CONSTEXPR cb_element_owner& operator=(cb_element_owner&& other)
+            {
+                if(this != &other)
+                    this->assign_buffer(std::move(other));
+
+                return *this;
+            }
+
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+            JM_CB_CXX20_CONSTEXPR ~cb_element_owner()
+            {
+                this->destroy_n(this->begin_index(), this->size());
+            }
+        };
+
+        template<class T, class Storage>
+        class cb_element_owner<T, Storage, true /* trivially copyable */>
+            : public cb_base<T, Storage> {
+        protected:
+            JM_CB_CONSTEXPR cb_element_owner() : cb_base<T, Storage>() {}
+        };
+
+        // overloads of the standard algorithms that work on whole segments. They are
+        // found by argument dependent lookup for unqualified calls and are more
+        // specialized than the ones in std.
+        template<class S, class TC, class W, class OutputIt>
+        JM_CB_CXX20_CONSTEXPR OutputIt
+        copy(cb_iterator<S, TC, W> first, cb_iterator<S, TC, W> last, OutputIt dest)
+        {
+            if(cb_is_constant_evaluated()) {
+                for(; first != last; ++first, ++dest)
+                    *dest = *first;
+                return dest;
+            }
 
+            const cb_segments<TC> s = first.segments(last);
+            dest                    = std::copy(s.one, s.one + s.one_count, dest);
+            return std::copy(s.two, s.two + s.two_count, dest);
+        }
 
-    template<typename T, std::size_t N>
-    class circular_buffer {
-    public:
-        typedef T                                                      value_type;
-        typedef std::size_t                                            size_type;
-        typedef std::ptrdiff_t                                         difference_type;
-        typedef T&                                                     reference;
-        typedef const T&                                               const_reference;
-        typedef T*                                                     pointer;
-        typedef const T*                                               const_pointer;
-        typedef detail::cb_iterator<detail::optional_storage<T>, T, N> iterator;
-        typedef detail::cb_iterator<const detail::optional_storage<T>, const T, N>
-                                                      const_iterator;
-        typedef std::reverse_iterator<iterator>       reverse_iterator;
-        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+        template<class S, class TC, class W, class U>
+        JM_CB_CXX20_CONSTEXPR cb_iterator<S, TC, W>
+        find(cb_iterator<S, TC, W> first, cb_iterator<S, TC, W> last, const U& value)
+        {
+            if(cb_is_constant_evaluated()) {
+                while(first != last && !(*first == value))
+                    ++first;
+                return first;
+            }
 
-    private:
-        typedef detail::cb_index_wrapper<size_type, N> wrapper_t;
-        typedef detail::optional_storage<T>            storage_type;
+            const cb_segments<TC> s = first.segments(last);
 
-        size_type    _head;
-        size_type    _tail;
-        size_type    _size;
-        storage_type _buffer[N];
+            TC* found = std::find(s.one, s.one + s.one_count, value);
+            if(found != s.one + s.one_count)
+                return first + (found - s.one);
 
-        inline void destroy(size_type idx) JM_CB_NOEXCEPT { _buffer[idx]._value.~T(); }
+            found = std::find(s.two, s.two + s.two_count, value);
+            return first + static_cast<std::ptrdiff_t>(s.one_count) + (found - s.two);
+        }
 
-        inline void copy_buffer(const circular_buffer& other)
+        template<class S, class TC, class W, class U>
+        JM_CB_CXX20_CONSTEXPR void
+        fill(cb_iterator<S, TC, W> first, cb_iterator<S, TC, W> last, const U& value)
         {
-            const_iterator       first = other.cbegin();
-            const const_iterator last  = other.cend();
+            if(cb_is_constant_evaluated()) {
+                for(; first != last; ++first)
+                    *first = value;
+                return;
+            }
 
-            for(; first != last; ++first)
-                push_back(*first);
+            const cb_segments<TC> s = first.segments(last);
+            std::fill(s.one, s.one + s.one_count, value);
+            std::fill(s.two, s.two + s.two_count, value);
         }
 
+    } // namespace detail
+
+    using detail::copy;
+    using detail::find;
+    using detail::fill;
+
+    /// smallest capacity of at least N whose elements fill whole lines of Alignment bytes
+    template<class T,
+             std::size_t N,
+             std::size_t Alignment = JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE>
+    struct cache_line_capacity {
+        static const std::size_t value =
+            (N * sizeof(T) + Alignment - 1) / Alignment * Alignment / sizeof(T);
+    };
 
 #if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
 
-        inline void move_buffer(circular_buffer&& other)
-        {
-            iterator       first = other.begin();
-            const iterator last  = other.end();
+    /// true if moving a T to another address and destroying the original can be done
+    /// by copying its bytes instead. Specialize it for such types that are not
+    /// trivially copyable, e.g. ones that own a heap allocation, and dynamic buffers
+    /// relocate them with memcpy when they reallocate.
+    template<class T>
+    struct is_trivially_relocatable
+        : std::integral_constant<bool, JM_CB_IS_TRIVIALLY_COPYABLE(T)> {
+    };
 
-            for(; first != last; ++first)
-                emplace_back(std::move(*first));
-        }
+    template<class T>
+    struct is_trivially_relocatable<std::allocator<T>> : std::true_type {
+    };
 
 #endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
 
+    /// Alignment other than 0 aligns the elements to that boundary and keeps the
+    /// indices on their own cache line, for example JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE
+    /// for buffers used by different threads next to each other.
+    /// Streaming is a jm::streaming policy for large buffers that are passed through.
+    template<typename T, std::size_t N, std::size_t Alignment = 0, class Streaming = no_streaming>
+    class circular_buffer
+        : public detail::cb_element_owner<T,
+                                          detail::cb_static_storage<T, N, Alignment, Streaming>> {
+        typedef detail::cb_element_owner<T, detail::cb_static_storage<T, N, Alignment, Streaming>>
+            base_type;
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+        static_assert(Streaming::prefetch_distance < N,
+                      "the prefetch distance has to be smaller than the capacity");
+#endif
+
     public:
-        JM_CB_CONSTEXPR explicit circular_buffer()
-            : _head(1), _tail(0), _size(0), _buffer()
-        {}
+        typedef typename base_type::size_type size_type;
+
+        JM_CB_CONSTEXPR explicit circular_buffer() : base_type() {}
 
 #if defined(JM_CIRCULAR_BUFFER_CXX_OLD)
         explicit
 #endif
-            circular_buffer(size_type count, const T& value = T())
-            : _head(0), _tail(count - 1), _size(count), _buffer()
+            JM_CB_CXX20_CONSTEXPR circular_buffer(size_type count, const T& value = T())
+            : base_type()
         {
-            if(JM_CB_UNLIKELY(_size > N))
+            if(JM_CB_UNLIKELY(count > N))
                 throw std::out_of_range(
                     "circular_buffer<T, N>(size_type count, const T&) count exceeded N");
 
-            if(JM_CB_LIKELY(_size != 0))
-                for(size_type i = 0; i < count; ++i)
-                    new(JM_CB_ADDRESSOF(_buffer[i]._value)) T(value);
-            else
-                _head = 1;
+            for(size_type i = 0; i < count; ++i)
+                this->push_back(value);
         }
 
         template<typename InputIt>
-        circular_buffer(InputIt first, InputIt last)
-            : _head(0), _tail(0), _size(0), _buffer()
+        JM_CB_CXX20_CONSTEXPR circular_buffer(InputIt first, InputIt last) : base_type()
         {
-            if(first != last) {
-                for(; first != last; ++first, ++_size) {
-                    if(JM_CB_UNLIKELY(_size >= N))
-                        throw std::out_of_range(
-                            "circular_buffer<T, N>(InputIt first, InputIt last) distance exceeded N");
-
-                    new(JM_CB_ADDRESSOF(_buffer[_size]._value)) T(*first);
-                }
+            for(; first != last; ++first) {
+                if(JM_CB_UNLIKELY(this->size() >= N))
+                    throw std::out_of_range(
+                        "circular_buffer<T, N>(InputIt first, InputIt last) distance exceeded N");
 
-                _tail = _size - 1;
+                this->push_back(*first);
             }
-            else
-                _head = 1;
         }
 
 #if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
 
-        circular_buffer(std::initializer_list<T> init)
-            : _head(0), _tail(init.size() - 1), _size(init.size()), _buffer()
+        JM_CB_CXX20_CONSTEXPR circular_buffer(std::initializer_list<T> init) : base_type()
         {
-            if(JM_CB_UNLIKELY(_size > N))
+            if(JM_CB_UNLIKELY(init.size() > N))
                 throw std::out_of_range(
                     "circular_buffer<T, N>(std::initializer_list<T> init) init.size() > N");
 
-            if(JM_CB_UNLIKELY(_size == 0))
-                _head = 1;
-
-            storage_type* buf_ptr = _buffer;
-            for(auto it = init.begin(), end = init.end(); it != end; ++it, ++buf_ptr)
-                new(JM_CB_ADDRESSOF(buf_ptr->_value)) T(*it);
+            this->append_n(init.begin(), init.size());
         }
 
 #endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+    };
+
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+    // the elements are stored inline and nothing refers to the buffer itself
+    template<typename T, std::size_t N, std::size_t Alignment, class Streaming>
+    struct is_trivially_relocatable<circular_buffer<T, N, Alignment, Streaming>>
+        : is_trivially_relocatable<T> {
+    };
 
-        circular_buffer(const circular_buffer& other)
-            : _head(1), _tail(0), _size(0), _buffer()
+    /// circular buffer with the capacity chosen at runtime and the slots allocated
+    /// through Allocator. A default constructed buffer has no capacity, so give it
+    /// one with set_capacity or reserve before pushing into it. Pushes into a buffer
+    /// without capacity do nothing.
+    template<typename T, class Allocator = std::allocator<T>>
+    class dynamic_circular_buffer
+        : public detail::cb_element_owner<T, detail::cb_dynamic_storage<T, Allocator>, false> {
+        typedef detail::cb_element_owner<T, detail::cb_dynamic_storage<T, Allocator>, false>
+                                                 base_type;
+        typedef typename base_type::storage_type storage_type;
+        typedef typename base_type::alloc_traits alloc_traits;
+
+    public:
+        typedef typename base_type::size_type size_type;
+        typedef typename base_type::iterator  iterator;
+        typedef Allocator                     allocator_type;
+
+        explicit dynamic_circular_buffer(const Allocator& alloc = Allocator())
+            : base_type(0, alloc)
+        {}
+
+        explicit dynamic_circular_buffer(size_type capacity, const Allocator& alloc = Allocator())
+            : base_type(capacity, alloc)
+        {}
+
+        dynamic_circular_buffer(size_type        capacity,
+                                size_type        count,
+                                const T&         value,
+                                const Allocator& alloc = Allocator())
+            : base_type(capacity, alloc)
+        {
+            if(JM_CB_UNLIKELY(count > capacity))
+                throw std::out_of_range(
+                    "dynamic_circular_buffer<T>(size_type capacity, size_type count, const T&) count exceeded capacity");
+
+            for(size_type i = 0; i < count; ++i)
+                this->push_back(value);
+        }
+
+        template<typename InputIt,
+                 class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+        dynamic_circular_buffer(size_type        capacity,
+                                InputIt          first,
+                                InputIt          last,
+                                const Allocator& alloc = Allocator())
+            : base_type(capacity, alloc)
         {
-            copy_buffer(other);
+            for(; first != last; ++first) {
+                if(JM_CB_UNLIKELY(this->size() >= capacity))
+                    throw std::out_of_range(
+                        "dynamic_circular_buffer<T>(size_type capacity, InputIt first, InputIt last) distance exceeded capacity");
+
+                this->push_back(*first);
+            }
         }
 
-        circular_buffer& operator=(const circular_buffer& other)
+        /// the capacity is init.size()
+        dynamic_circular_buffer(std::initializer_list<T> init,
+                                const Allocator&         alloc = Allocator())
+            : base_type(init.size(), alloc)
         {
-            clear();
-            copy_buffer(other);
-            return *this;
+            this->append_n(init.begin(), init.size());
         }
 
-#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+        dynamic_circular_buffer(const dynamic_circular_buffer& other)
+            : base_type(other.capacity(),
+                        alloc_traits::select_on_container_copy_construction(other._allocator))
+        {
+            this->copy_buffer(other);
+        }
+
+        dynamic_circular_buffer(dynamic_circular_buffer&& other) JM_CB_NOEXCEPT
+            : base_type(0, other._allocator)
+        {
+            swap_state(other);
+        }
 
-        circular_buffer(circular_buffer&& other) : _head(1), _tail(0), _size(0), _buffer()
+        dynamic_circular_buffer& operator=(const dynamic_circular_buffer& other)
         {
-            move_buffer(std::move(other));
+            if(this == &other)
+                return *this;
+
+            if(alloc_traits::propagate_on_container_copy_assignment::value) {
+                // the storage has to be released by the allocator that allocated it
+                if(this->_allocator != other._allocator) {
+                    this->clear();
+                    this->replace_storage(this->allocate(0), 0);
+                    this->reset_indices();
+                }
+
+                this->_allocator = other._allocator;
+            }
+
+            if(this->capacity() != other.capacity()) {
+                this->clear();
+                this->replace_storage(this->allocate(other.capacity()), other.capacity());
+                this->reset_indices();
+            }
+
+            this->assign_buffer(other);
+            return *this;
         }
 
-        circular_buffer& operator=(circular_buffer&& other)
+        dynamic_circular_buffer& operator=(dynamic_circular_buffer&& other)
         {
-            clear();
-            move_buffer(std::move(other));
+            if(this == &other)
+                return *this;
+
+            if(alloc_traits::propagate_on_container_move_assignment::value ||
+               this->_allocator == other._allocator) {
+                this->clear();
+                this->replace_storage(this->allocate(0), 0);
+                if(alloc_traits::propagate_on_container_move_assignment::value)
+                    this->_allocator = std::move(other._allocator);
+
+                this->reset_indices();
+                swap_state(other);
+            }
+            else {
+                // the storage can't change owners so the elements are moved one by one
+                if(this->capacity() != other.capacity()) {
+                    this->clear();
+                    this->replace_storage(this->allocate(other.capacity()), other.capacity());
+                    this->reset_indices();
+                }
+
+                this->assign_buffer(std::move(other));
+                other.clear();
+            }
+
             return *this;
         }
 
+        void swap(dynamic_circular_buffer& other) JM_CB_NOEXCEPT { swap_state(other); }
+
+        friend void swap(dynamic_circular_buffer& lhs, dynamic_circular_buffer& rhs)
+            JM_CB_NOEXCEPT
+        {
+            lhs.swap(rhs);
+        }
+
+        allocator_type get_allocator() const { return allocator_type(this->_allocator); }
+
+        /// makes sure that the capacity is at least new_capacity.
+        /// invalidates all iterators if the storage is reallocated.
+        void reserve(size_type new_capacity)
+        {
+            if(new_capacity > this->capacity())
+                set_capacity(new_capacity);
+        }
+
+        /// reduces the capacity to size(), which leaves the buffer full.
+        /// invalidates all iterators if the storage is reallocated.
+        void shrink_to_fit() { set_capacity(this->size()); }
+
+        /// reallocates the storage to hold new_capacity elements. If there are more
+        /// elements than fit, only the first new_capacity of them are kept.
+        /// Invalidates all iterators. The buffer is unchanged if an exception is thrown
+        /// while allocating or, if T is nothrow move constructible, while moving.
+        void set_capacity(size_type new_capacity)
+        {
+            if(new_capacity == this->capacity())
+                return;
+
+            const size_type count  = (this->size() < new_capacity) ? this->size() : new_capacity;
+            storage_type*   buffer = this->allocate(new_capacity);
+
+            if(is_trivially_relocatable<T>::value)
+                relocate_front(buffer, count);
+            else {
+                size_type i = 0;
+                try {
+                    for(iterator it = this->begin(); i < count; ++i, ++it)
+                        new(JM_CB_ADDRESSOF(buffer[i]._value)) T(std::move_if_noexcept(*it));
+                }
+                catch(...) {
+                    detail::cb_destroyer<T>::destroy_n(JM_CB_ADDRESSOF(buffer[0]._value), i);
+                    this->deallocate(buffer, new_capacity);
+                    throw;
+                }
+
+                // only the elements that did not fit are popped, the moved from ones
+                // are destroyed without being recorded
+                this->record_pop(this->size() - count);
+                this->drop_front(this->size());
+            }
+
+            this->replace_storage(buffer, new_capacity);
+
+            // the moved elements start at slot 0, so the empty state is placed before it
+            this->_head = 0;
+            this->_tail = this->wrapper().decrement(0);
+            this->grow_back(count);
+        }
+
+    private:
+        void swap_state(dynamic_circular_buffer& other) JM_CB_NOEXCEPT
+        {
+            this->swap_storage(other);
+            this->swap_indices(other);
+        }
+
+        // copies the bytes of the first count elements to buffer and destroys the
+        // rest, which leaves this empty without destroying the relocated elements.
+        // Only the destroyed ones are recorded as popped.
+        void relocate_front(storage_type* buffer, size_type count) JM_CB_NOEXCEPT
+        {
+            typedef typename base_type::array_range array_range;
+
+            const array_range one       = this->array_one();
+            const array_range two       = this->array_two();
+            const size_type   one_count = (one.second < count) ? one.second : count;
+
+            std::memcpy(static_cast<void*>(buffer),
+                        static_cast<const void*>(one.first),
+                        one_count * sizeof(T));
+            std::memcpy(static_cast<void*>(buffer + one_count),
+                        static_cast<const void*>(two.first),
+                        (count - one_count) * sizeof(T));
+
+            this->destroy_n(this->wrapper().index(this->wrapper().advance(
+                                this->_head, static_cast<std::ptrdiff_t>(count))),
+                            this->size() - count);
+            this->record_pop(this->size() - count);
+            this->reset_size();
+            this->reset_indices();
+        }
+    };
+
+    // the slots are owned through a pointer, so only the allocator has to be relocatable
+    template<typename T, class Allocator>
+    struct is_trivially_relocatable<dynamic_circular_buffer<T, Allocator>>
+        : is_trivially_relocatable<Allocator> {
+    };
+
+#if defined(__has_include) && __cplusplus >= 201703L
+#if __has_include(<memory_resource>)
+
+    namespace pmr {
+
+        template<typename T>
+        using dynamic_circular_buffer =
+            jm::dynamic_circular_buffer<T, std::pmr::polymorphic_allocator<T>>;
+
+    } // namespace pmr
+
+#endif
+#endif
+
 #endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
 
-        ~circular_buffer() { clear(); }
 
-        /// capacity
-        JM_CB_CONSTEXPR bool empty() const JM_CB_NOEXCEPT { return _size == 0; }
+#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
+    namespace detail {
+
+        inline void cb_cpu_relax() noexcept
+        {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+            __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+            _mm_pause();
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__arm__))
+            __asm__ __volatile__("yield");
+#endif
+        }
+
+    } // namespace detail
+
+    /// wait strategies for the blocking operations of the concurrent rings.
+    /// wait(atomic, old) is called while atomic still holds old and may return
+    /// spuriously. notify(atomic) is called after every store to it.
+    struct spin_wait {
+        template<class Atomic, class Value>
+        static void wait(const Atomic&, Value) noexcept
+        {
+            detail::cb_cpu_relax();
+        }
+
+        template<class Atomic>
+        static void notify(Atomic&) noexcept
+        {}
+    };
 
-        JM_CB_CONSTEXPR bool full() const JM_CB_NOEXCEPT { return _size == N; }
+    struct yield_wait {
+        template<class Atomic, class Value>
+        static void wait(const Atomic&, Value) noexcept
+        {
+            std::this_thread::yield();
+        }
 
-        JM_CB_CONSTEXPR size_type size() const JM_CB_NOEXCEPT { return _size; }
+        template<class Atomic>
+        static void notify(Atomic&) noexcept
+        {}
+    };
 
-        JM_CB_CONSTEXPR size_type max_size() const JM_CB_NOEXCEPT { return N; }
+    /// sleeps in the kernel using std::atomic::wait ( a futex on linux ) when it is
+    /// available and falls back to yield_wait otherwise.
+    struct atomic_wait {
+        template<class Atomic, class Value>
+        static void wait(const Atomic& atomic, Value old) noexcept
+        {
+#if defined(__cpp_lib_atomic_wait)
+            atomic.wait(old, std::memory_order_relaxed);
+#else
+            (void)atomic;
+            (void)old;
+            std::this_thread::yield();
+#endif
+        }
 
-        /// element access
-        JM_CB_CXX14_CONSTEXPR reference front() JM_CB_NOEXCEPT
+        template<class Atomic>
+        static void notify(Atomic& atomic) noexcept
         {
-            return _buffer[_head]._value;
+#if defined(__cpp_lib_atomic_wait)
+            atomic.notify_all();
+#else
+            (void)atomic;
+#endif
         }
+    };
 
-        JM_CB_CONSTEXPR const_reference front() const JM_CB_NOEXCEPT
+    /// slots of a concurrent ring handed out in one batch, one followed by two
+    template<class T>
+    struct ring_segments {
+        std::pair<T*, std::size_t> one;
+        std::pair<T*, std::size_t> two;
+
+        std::size_t size() const noexcept { return one.second + two.second; }
+        bool        empty() const noexcept { return size() == 0; }
+
+        /// the slot at pos of the batch
+        T* operator[](std::size_t pos) const noexcept
         {
-            return _buffer[_head]._value;
+            return (pos < one.second) ? one.first + pos : two.first + (pos - one.second);
         }
+    };
+
+    /// lock free ring for exactly one producer and one consumer thread.
+    /// try_push family may only be called by the producer and try_pop family by the
+    /// consumer, everything else is only approximate while both are running.
+    template<typename T, std::size_t N>
+    class spsc_circular_buffer {
+    public:
+        typedef T              value_type;
+        typedef std::size_t    size_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T&             reference;
+        typedef const T&       const_reference;
+        typedef T*             pointer;
+        typedef const T*       const_pointer;
+
+    private:
+        // positions run over [0, 2N) so that full and empty can be told apart without
+        // a shared size
+        typedef detail::cb_index_wrapper<size_type, 2 * N> position_t;
+        typedef detail::optional_storage<T>                storage_type;
+        typedef detail::cb_copier<T>                       copier_t;
 
-        JM_CB_CXX14_CONSTEXPR reference back() JM_CB_NOEXCEPT
+        // producer
+        alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) std::atomic<size_type> _tail;
+        size_type _cached_head;
+
+        // consumer
+        alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) std::atomic<size_type> _head;
+        size_type _cached_tail;
+
+        alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) storage_type _buffer[N];
+
+        static constexpr size_type index(size_type pos) noexcept
         {
-            return _buffer[_tail]._value;
+            return (pos < N) ? pos : pos - N;
         }
 
-        JM_CB_CONSTEXPR const_reference back() const JM_CB_NOEXCEPT
+        static constexpr size_type distance(size_type from, size_type to) noexcept
         {
-            return _buffer[_tail]._value;
+            return (to >= from) ? to - from : to + 2 * N - from;
         }
 
-        JM_CB_CXX14_CONSTEXPR pointer data() JM_CB_NOEXCEPT
+        static constexpr size_type contiguous(size_type idx, size_type count) noexcept
         {
-            return JM_CB_ADDRESSOF(_buffer[0]._value);
+            return (count < N - idx) ? count : N - idx;
         }
 
-        JM_CB_CONSTEXPR const_pointer data() const JM_CB_NOEXCEPT
+        pointer element(size_type pos) noexcept
         {
-            return JM_CB_ADDRESSOF(_buffer[0]._value);
+            return std::addressof(_buffer[index(pos)]._value);
         }
 
-        /// modifiers
-        void push_back(const value_type& value)
+        // returns the number of slots the producer may fill, count is what it would like
+        size_type writable(size_type tail, size_type count) noexcept
         {
-            size_type new_tail;
-            if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(_size == N)) {
-                new_tail = _head;
-                _head    = wrapper_t::increment(_head);
-                --_size;
-                _buffer[new_tail]._value = value;
-            }
-            else {
-                new_tail = wrapper_t::increment(_tail);
-                new(JM_CB_ADDRESSOF(_buffer[new_tail]._value)) T(value);
+            size_type available = N - distance(_cached_head, tail);
+            if(available < count) {
+                _cached_head = _head.load(std::memory_order_acquire);
+                available    = N - distance(_cached_head, tail);
             }
 
-            _tail = new_tail;
-            ++_size;
+            return (count < available) ? count : available;
         }
 
-        void push_front(const value_type& value)
+        // returns the number of elements the consumer may take, count is what it wants
+        size_type readable(size_type head, size_type count) noexcept
         {
-            size_type new_head = 0;
-            if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(_size == N)) {
-                new_head = _tail;
-                _tail    = wrapper_t::decrement(_tail);
-                --_size;
-                _buffer[new_head]._value = value;
+            size_type available = distance(head, _cached_tail);
+            if(available < count) {
+                _cached_tail = _tail.load(std::memory_order_acquire);
+                available    = distance(head, _cached_tail);
             }
-            else {
-                new_head = wrapper_t::decrement(_head);
-                new(JM_CB_ADDRESSOF(_buffer[new_head]._value)) T(value);
+
+            return (count < available) ? count : available;
+        }
+
+        ring_segments<T> segments(size_type pos, size_type count) noexcept
+        {
+            const size_type  first_count = contiguous(index(pos), count);
+            ring_segments<T> result      = {
+                std::make_pair(element(pos), first_count),
+                std::make_pair(std::addressof(_buffer[0]._value), count - first_count)};
+            return result;
+        }
+
+        // only assigns, the sources stay alive until destroy_out so an assignment
+        // that throws leaves every element in the ring
+        static void move_out(pointer src, size_type count, pointer dest)
+        {
+            if(JM_CB_IS_TRIVIALLY_COPYABLE(T)) {
+                copier_t::copy_n(src, count, dest);
+                return;
             }
 
-            _head = new_head;
-            ++_size;
+            for(size_type i = 0; i < count; ++i)
+                dest[i] = detail::move_if_noexcept_assign(src[i]);
         }
 
-#if !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+        void destroy_out(size_type head, size_type count) noexcept
+        {
+            const size_type first_count = contiguous(index(head), count);
+            detail::cb_destroyer<T>::destroy_n(element(head), first_count);
+            detail::cb_destroyer<T>::destroy_n(std::addressof(_buffer[0]._value),
+                                               count - first_count);
+        }
 
-        void push_back(value_type&& value)
+    public:
+        spsc_circular_buffer() noexcept
+            : _tail(0), _cached_head(0), _head(0), _cached_tail(0)
+        {}
+
+        spsc_circular_buffer(const spsc_circular_buffer&) = delete;
+        spsc_circular_buffer& operator=(const spsc_circular_buffer&) = delete;
+
+        ~spsc_circular_buffer()
+        {
+            size_type head = _head.load(std::memory_order_relaxed);
+            size_type size = distance(head, _tail.load(std::memory_order_relaxed));
+            for(; size != 0; --size, head = position_t::increment(head))
+                element(head)->~T();
+        }
+
+        /// capacity
+        bool empty() const noexcept
+        {
+            return _head.load(std::memory_order_acquire) ==
+                   _tail.load(std::memory_order_acquire);
+        }
+
+        bool full() const noexcept { return size() == N; }
+
+        size_type size() const noexcept
+        {
+            const size_type head = _head.load(std::memory_order_acquire);
+            return distance(head, _tail.load(std::memory_order_acquire));
+        }
+
+        constexpr size_type max_size() const noexcept { return N; }
+
+        /// producer
+        template<typename... Args>
+        bool try_emplace(Args&&... args)
+        {
+            const size_type tail = _tail.load(std::memory_order_relaxed);
+            if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(writable(tail, 1) == 0))
+                return false;
+
+            new(element(tail)) value_type(std::forward<Args>(args)...);
+            _tail.store(position_t::increment(tail), std::memory_order_release);
+            return true;
+        }
+
+        bool try_push(const value_type& value) { return try_emplace(value); }
+
+        bool try_push(value_type&& value) { return try_emplace(std::move(value)); }
+
+        /// pushes up to count elements from src and publishes them at once.
+        /// returns the number of elements that were pushed.
+        size_type try_push(const_pointer src, size_type count)
         {
-            size_type new_tail;
-            if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(_size == N)) {
-                new_tail = _head;
-                _head    = wrapper_t::increment(_head);
-                --_size;
-                _buffer[new_tail]._value = detail::move_if_noexcept_assign(value);
+            const size_type tail = _tail.load(std::memory_order_relaxed);
+            count                = writable(tail, count);
+            if(count == 0)
+                return 0;
+
+            const size_type first_count = contiguous(index(tail), count);
+            copier_t::uninitialized_copy_n(src, first_count, element(tail));
+            try {
+                copier_t::uninitialized_copy_n(src + first_count,
+                                               count - first_count,
+                                               std::addressof(_buffer[0]._value));
             }
-            else {
-                new_tail = wrapper_t::increment(_tail);
-                new(JM_CB_ADDRESSOF(_buffer[new_tail]._value))
-                    T(std::move_if_noexcept(value));
+            catch(...) {
+                detail::cb_destroyer<T>::destroy_n(element(tail), first_count);
+                throw;
             }
 
-            _tail = new_tail;
-            ++_size;
+            _tail.store(position_t::advance(tail, static_cast<difference_type>(count)),
+                        std::memory_order_release);
+            return count;
+        }
+
+        /// up to count free slots following the last element, which hold no objects.
+        /// Construct the elements in place and publish the first n of them with
+        /// commit(n), the slots stay reserved until then.
+        ring_segments<T> reserve(size_type count) noexcept
+        {
+            const size_type tail = _tail.load(std::memory_order_relaxed);
+            return segments(tail, writable(tail, count));
+        }
+
+        /// publishes the first count reserved slots, which must have been constructed
+        void commit(size_type count) noexcept
+        {
+            const size_type tail = _tail.load(std::memory_order_relaxed);
+            _tail.store(position_t::advance(tail, static_cast<difference_type>(count)),
+                        std::memory_order_release);
+        }
+
+        /// consumer
+        bool try_pop(reference out)
+        {
+            const size_type head = _head.load(std::memory_order_relaxed);
+            if(readable(head, 1) == 0)
+                return false;
+
+            move_out(element(head), 1, std::addressof(out));
+            destroy_out(head, 1);
+            _head.store(position_t::increment(head), std::memory_order_release);
+            return true;
+        }
+
+        /// pops up to count elements into dest and releases their slots at once.
+        /// returns the number of elements that were popped.
+        size_type try_pop(pointer dest, size_type count)
+        {
+            const size_type head = _head.load(std::memory_order_relaxed);
+            count                = readable(head, count);
+            if(count == 0)
+                return 0;
+
+            const size_type first_count = contiguous(index(head), count);
+            move_out(element(head), first_count, dest);
+            move_out(std::addressof(_buffer[0]._value),
+                     count - first_count,
+                     dest + first_count);
+            destroy_out(head, count);
+
+            _head.store(position_t::advance(head, static_cast<difference_type>(count)),
+                        std::memory_order_release);
+            return count;
+        }
+
+        /// up to count of the oldest elements, which may be read or moved from in
+        /// place until release
+        ring_segments<T> peek(size_type count) noexcept
+        {
+            const size_type head = _head.load(std::memory_order_relaxed);
+            return segments(head, readable(head, count));
+        }
+
+        /// destroys the first count peeked elements and hands their slots back to
+        /// the producer
+        void release(size_type count) noexcept
+        {
+            const size_type head = _head.load(std::memory_order_relaxed);
+            destroy_out(head, count);
+
+            _head.store(position_t::advance(head, static_cast<difference_type>(count)),
+                        std::memory_order_release);
+        }
+    };
+
+    /// bounded lock free ring for any number of producers and consumers.
+    /// every slot carries a sequence number telling which lap of the ring it is
+    /// ready for ( D. Vyukov's bounded mpmc queue ) so producers and consumers only
+    /// contend on their own position counter.
+    /// the blocking push and pop take a ticket and then wait on their slot using Wait.
+    template<typename T, std::size_t N, class Wait = spin_wait>
+    class mpmc_circular_buffer {
+    public:
+        typedef T              value_type;
+        typedef std::size_t    size_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T&             reference;
+        typedef const T&       const_reference;
+        typedef T*             pointer;
+        typedef const T*       const_pointer;
+
+        // a claimed slot can not be given back so nothing must throw after claiming
+        static_assert(std::is_nothrow_move_constructible<T>::value &&
+                          std::is_nothrow_move_assignable<T>::value,
+                      "mpmc_circular_buffer requires nothrow move operations");
+
+        /// slots claimed by reserve or peek
+        struct batch : ring_segments<T> {
+            size_type position;
+        };
+
+    private:
+        typedef detail::optional_storage<T>              storage_type;
+        typedef std::atomic<size_type>                   sequence_type;
+        typedef detail::cb_is_power_of_two<size_type, N> is_power_of_two;
+
+        alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) std::atomic<size_type> _enqueue_pos;
+        alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) std::atomic<size_type> _dequeue_pos;
+        alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) sequence_type _sequence[N];
+        alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) storage_type _buffer[N];
+
+        // positions only ever count up, for capacities which are not a power of two
+        // this costs a division.
+        static constexpr size_type index(size_type pos) noexcept
+        {
+            return is_power_of_two::value ? (pos & (N - 1)) : (pos % N);
+        }
+
+        static constexpr difference_type lag(size_type sequence, size_type pos) noexcept
+        {
+            return static_cast<difference_type>(sequence - pos);
         }
 
-        void push_front(value_type&& value)
+        // claims the next position whose slot has reached the wanted lap.
+        // wanted_offset is 0 for producers and 1 for consumers.
+        bool try_claim(std::atomic<size_type>& counter,
+                       size_type               wanted_offset,
+                       size_type&              pos) noexcept
         {
-            size_type new_head = 0;
-            if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(_size == N)) {
-                new_head = _tail;
-                _tail    = wrapper_t::decrement(_tail);
-                --_size;
-                _buffer[new_head]._value = detail::move_if_noexcept_assign(value);
+            pos = counter.load(std::memory_order_relaxed);
+            for(;;) {
+                const size_type sequence =
+                    _sequence[index(pos)].load(std::memory_order_acquire);
+                const difference_type diff = lag(sequence, pos + wanted_offset);
+
+                if(diff == 0) {
+                    if(counter.compare_exchange_weak(
+                           pos, pos + 1, std::memory_order_relaxed))
+                        return true;
+                }
+                else if(diff < 0)
+                    return false;
+                else
+                    pos = counter.load(std::memory_order_relaxed);
             }
-            else {
-                new_head = wrapper_t::decrement(_head);
-                new(JM_CB_ADDRESSOF(_buffer[new_head]._value))
-                    T(std::move_if_noexcept(value));
+        }
+
+        // claims up to count consecutive positions whose slots have all reached the
+        // wanted lap with a single compare exchange of the counter
+        size_type try_claim_n(std::atomic<size_type>& counter,
+                              size_type               wanted_offset,
+                              size_type               count,
+                              size_type&              pos) noexcept
+        {
+            pos = counter.load(std::memory_order_relaxed);
+            if(count == 0)
+                return 0;
+
+            for(;;) {
+                size_type       ready = 0;
+                difference_type diff  = 0;
+                while(ready < count &&
+                      (diff = lag(_sequence[index(pos + ready)].load(std::memory_order_acquire),
+                                  pos + ready + wanted_offset)) == 0)
+                    ++ready;
+
+                if(ready != 0) {
+                    if(counter.compare_exchange_weak(
+                           pos, pos + ready, std::memory_order_relaxed))
+                        return ready;
+                }
+                else if(diff < 0)
+                    return 0;
+                else
+                    pos = counter.load(std::memory_order_relaxed);
             }
+        }
 
-            _head = new_head;
-            ++_size;
+        batch make_batch(size_type pos, size_type count) noexcept
+        {
+            const size_type idx         = index(pos);
+            const size_type first_count = (count < N - idx) ? count : N - idx;
+
+            batch result;
+            result.one = std::make_pair(std::addressof(_buffer[idx]._value), first_count);
+            result.two = std::make_pair(std::addressof(_buffer[0]._value), count - first_count);
+            result.position = pos;
+            return result;
         }
 
-        template<typename... Args>
-        void emplace_back(Args&&... args)
+        void wait_for(size_type idx, size_type sequence) const noexcept
         {
-            size_type new_tail;
-            if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(_size == N)) {
-                new_tail = _head;
-                _head    = wrapper_t::increment(_head);
-                --_size;
-                destroy(new_tail);
-            }
-            else
-                new_tail = wrapper_t::increment(_tail);
+            for(size_type current = _sequence[idx].load(std::memory_order_acquire);
+                current != sequence;
+                current = _sequence[idx].load(std::memory_order_acquire))
+                Wait::wait(_sequence[idx], current);
+        }
 
-            new(JM_CB_ADDRESSOF(_buffer[new_tail]._value))
-                value_type(std::forward<Args>(args)...);
-            _tail = new_tail;
-            ++_size;
+        void publish(size_type idx, size_type sequence) noexcept
+        {
+            _sequence[idx].store(sequence, std::memory_order_release);
+            Wait::notify(_sequence[idx]);
         }
 
         template<typename... Args>
-        void emplace_front(Args&&... args)
+        void construct(size_type pos, std::true_type, Args&&... args) noexcept
         {
-            size_type new_head;
-            if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(_size == N)) {
-                new_head = _tail;
-                _tail    = wrapper_t::decrement(_tail);
-                --_size;
-                destroy(new_head);
-            }
-            else
-                new_head = wrapper_t::decrement(_head);
-
-            new(JM_CB_ADDRESSOF(_buffer[new_head]._value))
+            new(std::addressof(_buffer[index(pos)]._value))
                 value_type(std::forward<Args>(args)...);
-            _head = new_head;
-            ++_size;
+            publish(index(pos), pos + 1);
         }
 
-#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
-
-        JM_CB_CXX14_CONSTEXPR void pop_back() JM_CB_NOEXCEPT
+        void move_out(size_type pos, reference out) noexcept
         {
-            size_type old_tail = _tail;
-            --_size;
-            _tail = wrapper_t::decrement(_tail);
-            destroy(old_tail);
+            T& value = _buffer[index(pos)]._value;
+            out      = std::move(value);
+            value.~T();
+            publish(index(pos), pos + N);
         }
 
-        JM_CB_CXX14_CONSTEXPR void pop_front() JM_CB_NOEXCEPT
+        template<typename... Args>
+        bool try_emplace_impl(std::true_type nothrow, Args&&... args)
         {
-            size_type old_head = _head;
-            --_size;
-            _head = wrapper_t::increment(_head);
-            destroy(old_head);
+            size_type pos;
+            if(!try_claim(_enqueue_pos, 0, pos))
+                return false;
+
+            construct(pos, nothrow, std::forward<Args>(args)...);
+            return true;
         }
 
-        JM_CB_CXX14_CONSTEXPR void clear() JM_CB_NOEXCEPT
+        // throwing constructors run before a slot is claimed
+        template<typename... Args>
+        bool try_emplace_impl(std::false_type, Args&&... args)
         {
-            while(_size != 0)
-                pop_back();
+            value_type value(std::forward<Args>(args)...);
+            return try_emplace_impl(std::true_type(), std::move(value));
+        }
 
-            _head = 1;
-            _tail = 0;
+        template<typename... Args>
+        void emplace_impl(std::true_type nothrow, Args&&... args)
+        {
+            const size_type pos = _enqueue_pos.fetch_add(1, std::memory_order_relaxed);
+            wait_for(index(pos), pos);
+            construct(pos, nothrow, std::forward<Args>(args)...);
         }
 
-        /// iterators
-        JM_CB_CXX14_CONSTEXPR iterator begin() JM_CB_NOEXCEPT
+        template<typename... Args>
+        void emplace_impl(std::false_type, Args&&... args)
         {
-            if(_size == 0)
-                return end();
-            return iterator(_buffer, _head, _size);
+            value_type value(std::forward<Args>(args)...);
+            emplace_impl(std::true_type(), std::move(value));
         }
 
-        JM_CB_CXX14_CONSTEXPR const_iterator begin() const JM_CB_NOEXCEPT
+    public:
+        mpmc_circular_buffer() noexcept : _enqueue_pos(0), _dequeue_pos(0)
         {
-            if(_size == 0)
-                return end();
-            return const_iterator(_buffer, _head, _size);
+            for(size_type i = 0; i < N; ++i)
+                _sequence[i].store(i, std::memory_order_relaxed);
         }
 
-        JM_CB_CXX14_CONSTEXPR const_iterator cbegin() const JM_CB_NOEXCEPT
+        mpmc_circular_buffer(const mpmc_circular_buffer&) = delete;
+        mpmc_circular_buffer& operator=(const mpmc_circular_buffer&) = delete;
+
+        ~mpmc_circular_buffer()
         {
-            if(_size == 0)
-                return cend();
-            return const_iterator(_buffer, _head, _size);
+            const size_type last = _enqueue_pos.load(std::memory_order_relaxed);
+            size_type       pos  = _dequeue_pos.load(std::memory_order_relaxed);
+            for(; lag(last, pos) > 0; ++pos)
+                _buffer[index(pos)]._value.~T();
         }
 
-        JM_CB_CXX14_CONSTEXPR reverse_iterator rbegin() JM_CB_NOEXCEPT
+        /// capacity
+        size_type size() const noexcept
         {
-            if(_size == 0)
-                return rend();
-            return reverse_iterator(iterator(_buffer, _head, _size));
+            // blocked consumers can move the dequeue position past the enqueue one
+            const size_type       tail = _enqueue_pos.load(std::memory_order_acquire);
+            const difference_type size =
+                lag(tail, _dequeue_pos.load(std::memory_order_acquire));
+            if(size <= 0)
+                return 0;
+
+            return (static_cast<size_type>(size) > N) ? N : static_cast<size_type>(size);
         }
 
-        JM_CB_CXX14_CONSTEXPR const_reverse_iterator rbegin() const JM_CB_NOEXCEPT
+        bool empty() const noexcept { return size() == 0; }
+
+        bool full() const noexcept { return size() == N; }
+
+        constexpr size_type max_size() const noexcept { return N; }
+
+        /// producers
+        template<typename... Args>
+        bool try_emplace(Args&&... args)
         {
-            if(_size == 0)
-                return rend();
-            return const_reverse_iterator(const_iterator(_buffer, _head, _size));
+            return try_emplace_impl(std::is_nothrow_constructible<T, Args&&...>(),
+                                    std::forward<Args>(args)...);
         }
 
-        JM_CB_CXX14_CONSTEXPR const_reverse_iterator crbegin() const JM_CB_NOEXCEPT
+        bool try_push(const value_type& value) { return try_emplace(value); }
+
+        bool try_push(value_type&& value) { return try_emplace(std::move(value)); }
+
+        /// waits until there is space
+        template<typename... Args>
+        void emplace(Args&&... args)
         {
-            if(_size == 0)
-                return crend();
-            return const_reverse_iterator(const_iterator(_buffer, _head, _size));
+            emplace_impl(std::is_nothrow_constructible<T, Args&&...>(),
+                         std::forward<Args>(args)...);
         }
 
-        JM_CB_CXX14_CONSTEXPR iterator end() JM_CB_NOEXCEPT
+        void push(const value_type& value) { emplace(value); }
+
+        void push(value_type&& value) { emplace(std::move(value)); }
+
+        /// consumers
+        bool try_pop(reference out) noexcept
         {
-            return iterator(_buffer, wrapper_t::increment(_tail), 0);
+            size_type pos;
+            if(!try_claim(_dequeue_pos, 1, pos))
+                return false;
+
+            move_out(pos, out);
+            return true;
         }
 
-        JM_CB_CXX14_CONSTEXPR const_iterator end() const JM_CB_NOEXCEPT
+        /// waits until there is an element
+        void pop(reference out) noexcept
         {
-            return const_iterator(_buffer, wrapper_t::increment(_tail), 0);
+            const size_type pos = _dequeue_pos.fetch_add(1, std::memory_order_relaxed);
+            wait_for(index(pos), pos + 1);
+            move_out(pos, out);
         }
 
-        JM_CB_CXX14_CONSTEXPR const_iterator cend() const JM_CB_NOEXCEPT
+        /// batches
+        /// claims up to count free slots with a single compare exchange. They hold no
+        /// objects and every one of them has to be constructed and then published by
+        /// commit, since claimed slots can not be given back.
+        batch reserve(size_type count) noexcept
         {
-            return const_iterator(_buffer, wrapper_t::increment(_tail), 0);
+            size_type pos;
+            count = try_claim_n(_enqueue_pos, 0, count, pos);
+            return make_batch(pos, count);
         }
 
-        JM_CB_CXX14_CONSTEXPR reverse_iterator rend() JM_CB_NOEXCEPT
+        /// publishes every slot of b to the consumers
+        void commit(const batch& b) noexcept
         {
-            return reverse_iterator(iterator(_buffer, wrapper_t::increment(_tail), 0));
+            for(size_type i = 0; i < b.size(); ++i)
+                publish(index(b.position + i), b.position + i + 1);
         }
 
-        JM_CB_CXX14_CONSTEXPR const_reverse_iterator rend() const JM_CB_NOEXCEPT
+        /// claims up to count of the oldest elements with a single compare exchange.
+        /// They may be read or moved from in place and have to be given back by release.
+        batch peek(size_type count) noexcept
         {
-            return const_reverse_iterator(
-                const_iterator(_buffer, wrapper_t::increment(_tail), 0));
+            size_type pos;
+            count = try_claim_n(_dequeue_pos, 1, count, pos);
+            return make_batch(pos, count);
         }
 
-        JM_CB_CXX14_CONSTEXPR const_reverse_iterator crend() const JM_CB_NOEXCEPT
+        /// destroys the elements of b and hands their slots back to the producers
+        void release(const batch& b) noexcept
         {
-            return const_reverse_iterator(
-                const_iterator(_buffer, wrapper_t::increment(_tail), 0));
+            for(size_type i = 0; i < b.size(); ++i) {
+                (*b[i]).~T();
+                publish(index(b.position + i), b.position + i + N);
+            }
         }
     };
 
+#endif // !defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+
 } // namespace jm
 
 #endif // include guard
@@ -0,0 +1,340 @@
+/*
+ * Copyright 2017 Justas Masiulis
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JM_CIRCULAR_BUFFER_ALGORITHM_HPP
+#define JM_CIRCULAR_BUFFER_ALGORITHM_HPP
+
+#include "circular_buffer.hpp"
+
+// reductions over the contents of circular buffers. They run on the two contiguous
+// segments of the buffer instead of going through cb_iterator so that float and
+// double can use vector instructions. Vectorized sums add in a different order
+// than a sequential loop, so floating point results may differ in the last bits.
+//
+// the instruction set is picked at compile time from the target macros,
+// define JM_CIRCULAR_BUFFER_NO_SIMD to always use the scalar kernels
+
+#if !defined(JM_CIRCULAR_BUFFER_NO_SIMD)
+#if defined(__AVX__)
+#define JM_CB_SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JM_CB_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define JM_CB_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif // !defined(JM_CIRCULAR_BUFFER_NO_SIMD)
+
+namespace jm {
+
+    namespace detail {
+
+        // vector operations for T, only specialized where the target has them
+        template<class T>
+        struct cb_simd {
+            static const bool enabled = false;
+        };
+
+#if defined(JM_CB_SIMD_AVX)
+
+        template<>
+        struct cb_simd<float> {
+            static const bool        enabled = true;
+            static const std::size_t width   = 8;
+            typedef __m256           vec;
+
+            static vec load(const float* p) { return _mm256_loadu_ps(p); }
+            static void store(float* p, vec v) { _mm256_storeu_ps(p, v); }
+            static vec zero() { return _mm256_setzero_ps(); }
+            static vec add(vec a, vec b) { return _mm256_add_ps(a, b); }
+            static vec mul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+            static vec min(vec a, vec b) { return _mm256_min_ps(a, b); }
+            static vec max(vec a, vec b) { return _mm256_max_ps(a, b); }
+        };
+
+        template<>
+        struct cb_simd<double> {
+            static const bool        enabled = true;
+            static const std::size_t width   = 4;
+            typedef __m256d          vec;
+
+            static vec load(const double* p) { return _mm256_loadu_pd(p); }
+            static void store(double* p, vec v) { _mm256_storeu_pd(p, v); }
+            static vec zero() { return _mm256_setzero_pd(); }
+            static vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+            static vec mul(vec a, vec b) { return _mm256_mul_pd(a, b); }
+            static vec min(vec a, vec b) { return _mm256_min_pd(a, b); }
+            static vec max(vec a, vec b) { return _mm256_max_pd(a, b); }
+        };
+
+#elif defined(JM_CB_SIMD_SSE2)
+
+        template<>
+        struct cb_simd<float> {
+            static const bool        enabled = true;
+            static const std::size_t width   = 4;
+            typedef __m128           vec;
+
+            static vec load(const float* p) { return _mm_loadu_ps(p); }
+            static void store(float* p, vec v) { _mm_storeu_ps(p, v); }
+            static vec zero() { return _mm_setzero_ps(); }
+            static vec add(vec a, vec b) { return _mm_add_ps(a, b); }
+            static vec mul(vec a, vec b) { return _mm_mul_ps(a, b); }
+            static vec min(vec a, vec b) { return _mm_min_ps(a, b); }
+            static vec max(vec a, vec b) { return _mm_max_ps(a, b); }
+        };
+
+        template<>
+        struct cb_simd<double> {
+            static const bool        enabled = true;
+            static const std::size_t width   = 2;
+            typedef __m128d          vec;
+
+            static vec load(const double* p) { return _mm_loadu_pd(p); }
+            static void store(double* p, vec v) { _mm_storeu_pd(p, v); }
+            static vec zero() { return _mm_setzero_pd(); }
+            static vec add(vec a, vec b) { return _mm_add_pd(a, b); }
+            static vec mul(vec a, vec b) { return _mm_mul_pd(a, b); }
+            static vec min(vec a, vec b) { return _mm_min_pd(a, b); }
+            static vec max(vec a, vec b) { return _mm_max_pd(a, b); }
+        };
+
+#elif defined(JM_CB_SIMD_NEON)
+
+        template<>
+        struct cb_simd<float> {
+            static const bool        enabled = true;
+            static const std::size_t width   = 4;
+            typedef float32x4_t      vec;
+
+            static vec load(const float* p) { return vld1q_f32(p); }
+            static void store(float* p, vec v) { vst1q_f32(p, v); }
+            static vec zero() { return vdupq_n_f32(0.f); }
+            static vec add(vec a, vec b) { return vaddq_f32(a, b); }
+            static vec mul(vec a, vec b) { return vmulq_f32(a, b); }
+            static vec min(vec a, vec b) { return vminq_f32(a, b); }
+            static vec max(vec a, vec b) { return vmaxq_f32(a, b); }
+        };
+
+#if defined(__aarch64__)
+
+        template<>
+        struct cb_simd<double> {
+            static const bool        enabled = true;
+            static const std::size_t width   = 2;
+            typedef float64x2_t      vec;
+
+            static vec load(const double* p) { return vld1q_f64(p); }
+            static void store(double* p, vec v) { vst1q_f64(p, v); }
+            static vec zero() { return vdupq_n_f64(0.); }
+            static vec add(vec a, vec b) { return vaddq_f64(a, b); }
+            static vec mul(vec a, vec b) { return vmulq_f64(a, b); }
+            static vec min(vec a, vec b) { return vminq_f64(a, b); }
+            static vec max(vec a, vec b) { return vmaxq_f64(a, b); }
+        };
+
+#endif // defined(__aarch64__)
+
+#endif
+
+        // kernels over one contiguous segment
+        template<class T, bool = cb_simd<T>::enabled>
+        struct cb_kernels {
+            static T sum(const T* first, std::size_t count, T init)
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                    init += first[i];
+
+                return init;
+            }
+
+            static T dot(const T* first, const T* weights, std::size_t count, T init)
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                    init += first[i] * weights[i];
+
+                return init;
+            }
+
+            static void minmax(const T* first, std::size_t count, T& lo, T& hi)
+            {
+                for(std::size_t i = 0; i < count; ++i) {
+                    if(first[i] < lo)
+                        lo = first[i];
+                    if(hi < first[i])
+                        hi = first[i];
+                }
+            }
+        };
+
+        template<class T>
+        struct cb_kernels<T, true /* simd */> {
+            typedef cb_simd<T>          simd;
+            typedef typename simd::vec  vec;
+            typedef cb_kernels<T, false> scalar;
+
+            static T reduce_add(vec v)
+            {
+                T lanes[simd::width];
+                simd::store(lanes, v);
+                return scalar::sum(lanes, simd::width, T());
+            }
+
+            // two accumulators to hide the latency of the additions
+            static T sum(const T* first, std::size_t count, T init)
+            {
+                vec         acc0 = simd::zero();
+                vec         acc1 = simd::zero();
+                std::size_t i    = 0;
+                for(; i + 2 * simd::width <= count; i += 2 * simd::width) {
+                    acc0 = simd::add(acc0, simd::load(first + i));
+                    acc1 = simd::add(acc1, simd::load(first + i + simd::width));
+                }
+
+                if(i + simd::width <= count) {
+                    acc0 = simd::add(acc0, simd::load(first + i));
+                    i += simd::width;
+                }
+
+                init += reduce_add(simd::add(acc0, acc1));
+                return scalar::sum(first + i, count - i, init);
+            }
+
+            static T dot(const T* first, const T* weights, std::size_t count, T init)
+            {
+                vec         acc0 = simd::zero();
+                vec         acc1 = simd::zero();
+                std::size_t i    = 0;
+                for(; i + 2 * simd::width <= count; i += 2 * simd::width) {
+                    acc0 = simd::add(acc0, simd::mul(simd::load(first + i), simd::load(weights + i)));
+                    acc1 = simd::add(acc1,
+                                     simd::mul(simd::load(first + i + simd::width),
+                                               simd::load(weights + i + simd::width)));
+                }
+
+                if(i + simd::width <= count) {
+                    acc0 = simd::add(acc0, simd::mul(simd::load(first + i), simd::load(weights + i)));
+                    i += simd::width;
+                }
+
+                init += reduce_add(simd::add(acc0, acc1));
+                return scalar::dot(first + i, weights + i, count - i, init);
+            }
+
+            static void minmax(const T* first, std::size_t count, T& lo, T& hi)
+            {
+                if(count < simd::width) {
+                    scalar::minmax(first, count, lo, hi);
+                    return;
+                }
+
+                vec         vlo = simd::load(first);
+                vec         vhi = vlo;
+                std::size_t i   = simd::width;
+                for(; i + simd::width <= count; i += simd::width) {
+                    const vec v = simd::load(first + i);
+                    vlo         = simd::min(vlo, v);
+                    vhi         = simd::max(vhi, v);
+                }
+
+                T lanes[simd::width];
+                simd::store(lanes, vlo);
+                scalar::minmax(lanes, simd::width, lo, hi);
+                simd::store(lanes, vhi);
+                scalar::minmax(lanes, simd::width, lo, hi);
+                scalar::minmax(first + i, count - i, lo, hi);
+            }
+        };
+
+    } // namespace detail
+
+    namespace cb {
+
+        /// sum of all elements added to init
+        template<class Buffer>
+        typename Buffer::value_type
+        accumulate(const Buffer&               buffer,
+                   typename Buffer::value_type init = typename Buffer::value_type())
+        {
+            typedef detail::cb_kernels<typename Buffer::value_type> kernels;
+
+            const typename Buffer::const_array_range one = buffer.array_one();
+            const typename Buffer::const_array_range two = buffer.array_two();
+            init = kernels::sum(one.first, one.second, init);
+            return kernels::sum(two.first, two.second, init);
+        }
+
+        /// arithmetic mean of the elements, the buffer must not be empty
+        template<class Buffer>
+        typename Buffer::value_type mean(const Buffer& buffer)
+        {
+            typedef typename Buffer::value_type value_type;
+            return accumulate(buffer) / static_cast<value_type>(buffer.size());
+        }
+
+        /// smallest and largest element, the buffer must not be empty
+        template<class Buffer>
+        std::pair<typename Buffer::value_type, typename Buffer::value_type>
+        minmax(const Buffer& buffer)
+        {
+            typedef detail::cb_kernels<typename Buffer::value_type> kernels;
+
+            typename Buffer::value_type lo = buffer.front();
+            typename Buffer::value_type hi = lo;
+
+            const typename Buffer::const_array_range one = buffer.array_one();
+            const typename Buffer::const_array_range two = buffer.array_two();
+            kernels::minmax(one.first, one.second, lo, hi);
+            kernels::minmax(two.first, two.second, lo, hi);
+            return std::make_pair(lo, hi);
+        }
+
+        /// sum of the elements multiplied with weights, which holds size() values
+        /// with weights[0] belonging to front()
+        template<class Buffer>
+        typename Buffer::value_type
+        dot(const Buffer&                      buffer,
+            const typename Buffer::value_type* weights,
+            typename Buffer::value_type        init = typename Buffer::value_type())
+        {
+            typedef detail::cb_kernels<typename Buffer::value_type> kernels;
+
+            const typename Buffer::const_array_range one = buffer.array_one();
+            const typename Buffer::const_array_range two = buffer.array_two();
+            init = kernels::dot(one.first, weights, one.second, init);
+            return kernels::dot(two.first, weights + one.second, two.second, init);
+        }
+
+        /// replaces every element with op(element). The segments are plain loops over
+        /// pointers, so the compiler is free to vectorize op.
+        template<class Buffer, class UnaryOp>
+        void transform_inplace(Buffer& buffer, UnaryOp op)
+        {
+            typedef typename Buffer::array_range range_t;
+
+            const range_t ranges[2] = {buffer.array_one(), buffer.array_two()};
+            for(std::size_t r = 0; r < 2; ++r)
+                for(std::size_t i = 0; i < ranges[r].second; ++i)
+                    ranges[r].first[i] = op(ranges[r].first[i]);
+        }
+
+    } // namespace cb
+
+} // namespace jm
+
+#endif // JM_CIRCULAR_BUFFER_ALGORITHM_HPP
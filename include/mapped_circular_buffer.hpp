@@ -0,0 +1,366 @@
+/*
+ * Copyright 2017 Justas Masiulis
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JM_MAPPED_CIRCULAR_BUFFER_HPP
+#define JM_MAPPED_CIRCULAR_BUFFER_HPP
+
+#include "circular_buffer.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#if defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+#error "mapped_circular_buffer requires c++11"
+#endif
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "mapped_circular_buffer requires a posix system"
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace jm {
+
+    namespace detail {
+
+        // first bytes of the file. Everything is written in the native byte order,
+        // the file is only meant to be reopened on the same kind of machine.
+        struct cb_mapped_header {
+            char          magic[8];
+            std::uint32_t version;
+            std::uint32_t element_size;
+            std::uint32_t element_alignment;
+            std::uint32_t reserved;
+            std::uint64_t capacity;
+            std::uint64_t head;
+            std::uint64_t size;
+        };
+
+        static const char          cb_mapped_magic[8] = {'j', 'm', 'c', 'b', 'u', 'f', 0, 0};
+        static const std::uint32_t cb_mapped_version  = 1;
+
+        // the slots start on their own cache line after the header
+        template<class T>
+        struct cb_mapped_layout {
+            static const std::size_t alignment =
+                (alignof(T) > JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE)
+                    ? alignof(T)
+                    : JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE;
+
+            static const std::size_t slots_offset =
+                (sizeof(cb_mapped_header) + alignment - 1) / alignment * alignment;
+
+            static std::size_t file_size(std::size_t capacity) JM_CB_NOEXCEPT
+            {
+                return slots_offset + capacity * sizeof(T);
+            }
+        };
+
+        inline std::system_error cb_mapped_error(const char* what)
+        {
+            return std::system_error(errno, std::generic_category(), what);
+        }
+
+    } // namespace detail
+
+    /// circular buffer of trivially copyable records whose header and slots live in a
+    /// file mapped with MAP_SHARED. Reopening the file gives back the same contents
+    /// without deserialization and the data survives crashes of the process once
+    /// written, flush() additionally makes it survive crashes of the system.
+    /// Every operation leaves the file in a state that reopens to a valid buffer,
+    /// but it is not safe to use one file from several processes at once. Removing
+    /// the front shrinks the size before moving the head, so a crash in between can
+    /// lose the back element but never exposes a stale slot.
+    template<class T>
+    class mapped_circular_buffer {
+        typedef detail::optional_storage<T>                   storage_type;
+        typedef detail::cb_dynamic_index_wrapper<std::size_t> wrapper_type;
+        typedef detail::cb_mapped_layout<T>                   layout_type;
+
+        static_assert(JM_CB_IS_TRIVIALLY_COPYABLE(T),
+                      "mapped_circular_buffer requires trivially copyable elements");
+
+        int                       _fd;
+        void*                     _map;
+        std::size_t               _map_size;
+        detail::cb_mapped_header* _header;
+        storage_type*             _buffer;
+        wrapper_type              _wrapper;
+
+        // keeps the compiler from moving the element and header stores across each
+        // other, so that a crash in between leaves a consistent file
+        static void order_stores() JM_CB_NOEXCEPT
+        {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+
+        std::size_t end_index() const JM_CB_NOEXCEPT
+        {
+            return _wrapper.advance(static_cast<std::size_t>(_header->head),
+                                    static_cast<std::ptrdiff_t>(_header->size));
+        }
+
+        const char* map_begin() const JM_CB_NOEXCEPT { return static_cast<const char*>(_map); }
+
+        void sync(const void* first, std::size_t length) const
+        {
+            static const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+            const std::size_t offset = static_cast<std::size_t>(
+                static_cast<const char*>(first) - map_begin());
+            const std::size_t begin = offset / page * page;
+            if(::msync(const_cast<char*>(map_begin()) + begin, offset + length - begin,
+                       MS_SYNC) != 0)
+                throw detail::cb_mapped_error("msync");
+        }
+
+        void initialize(std::size_t capacity)
+        {
+            std::memcpy(_header->magic, detail::cb_mapped_magic, sizeof(_header->magic));
+            _header->version           = detail::cb_mapped_version;
+            _header->element_size      = sizeof(T);
+            _header->element_alignment = alignof(T);
+            _header->reserved          = 0;
+            _header->capacity          = capacity;
+            _header->head              = 0;
+            _header->size              = 0;
+        }
+
+        void validate(std::size_t capacity) const
+        {
+            if(std::memcmp(_header->magic, detail::cb_mapped_magic, sizeof(_header->magic)) !=
+               0)
+                throw std::runtime_error("mapped_circular_buffer: not a buffer file");
+            if(_header->version != detail::cb_mapped_version)
+                throw std::runtime_error("mapped_circular_buffer: unsupported file version");
+            if(_header->element_size != sizeof(T) || _header->element_alignment != alignof(T))
+                throw std::runtime_error("mapped_circular_buffer: element type mismatch");
+            if(_header->capacity != capacity)
+                throw std::runtime_error("mapped_circular_buffer: capacity mismatch");
+            if(_header->head >= capacity || _header->size > capacity)
+                throw std::runtime_error("mapped_circular_buffer: corrupted indices");
+        }
+
+        void close() JM_CB_NOEXCEPT
+        {
+            if(_map != JM_CB_NULLPTR)
+                ::munmap(_map, _map_size);
+            if(_fd != -1)
+                ::close(_fd);
+        }
+
+    public:
+        typedef T                 value_type;
+        typedef std::size_t       size_type;
+        typedef std::ptrdiff_t    difference_type;
+        typedef T&                reference;
+        typedef const T&          const_reference;
+        typedef T*                pointer;
+        typedef const T*          const_pointer;
+        typedef detail::cb_iterator<storage_type, T, wrapper_type> iterator;
+        typedef detail::cb_iterator<const storage_type, const T, wrapper_type> const_iterator;
+        typedef std::reverse_iterator<iterator>       reverse_iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+        /// opens the buffer stored at path, or creates it with room for capacity
+        /// elements if the file does not exist or is empty. Throws std::system_error if
+        /// the file cannot be opened or mapped and std::runtime_error if it holds a
+        /// buffer of a different version, element type or capacity.
+        mapped_circular_buffer(const char* path, size_type capacity)
+            : _fd(-1)
+            , _map(JM_CB_NULLPTR)
+            , _map_size(layout_type::file_size(capacity))
+            , _header(JM_CB_NULLPTR)
+            , _buffer(JM_CB_NULLPTR)
+            , _wrapper(capacity)
+        {
+            if(capacity == 0)
+                throw std::invalid_argument("mapped_circular_buffer: capacity of 0");
+
+            try {
+                _fd = ::open(path, O_RDWR | O_CREAT, 0644);
+                if(_fd == -1)
+                    throw detail::cb_mapped_error("open");
+
+                struct stat info;
+                if(::fstat(_fd, &info) != 0)
+                    throw detail::cb_mapped_error("fstat");
+
+                const bool created = (info.st_size == 0);
+                if(created) {
+                    if(::ftruncate(_fd, static_cast<off_t>(_map_size)) != 0)
+                        throw detail::cb_mapped_error("ftruncate");
+                }
+                else if(static_cast<std::size_t>(info.st_size) != _map_size)
+                    throw std::runtime_error("mapped_circular_buffer: capacity mismatch");
+
+                _map = ::mmap(JM_CB_NULLPTR, _map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                              _fd, 0);
+                if(_map == MAP_FAILED) {
+                    _map = JM_CB_NULLPTR;
+                    throw detail::cb_mapped_error("mmap");
+                }
+
+                _header = static_cast<detail::cb_mapped_header*>(_map);
+                _buffer = reinterpret_cast<storage_type*>(static_cast<char*>(_map) +
+                                                          layout_type::slots_offset);
+                if(created)
+                    initialize(capacity);
+                else
+                    validate(capacity);
+            } catch(...) {
+                close();
+                throw;
+            }
+        }
+
+        mapped_circular_buffer(const mapped_circular_buffer&) = delete;
+        mapped_circular_buffer& operator=(const mapped_circular_buffer&) = delete;
+
+        /// the changes are written back by the system eventually, call flush() first
+        /// to wait until they are
+        ~mapped_circular_buffer() { close(); }
+
+        size_type size() const JM_CB_NOEXCEPT { return static_cast<size_type>(_header->size); }
+        size_type capacity() const JM_CB_NOEXCEPT { return _wrapper.capacity(); }
+        bool      empty() const JM_CB_NOEXCEPT { return _header->size == 0; }
+        bool      full() const JM_CB_NOEXCEPT { return size() == capacity(); }
+
+        reference front() JM_CB_NOEXCEPT { return _buffer[_header->head]._value; }
+        const_reference front() const JM_CB_NOEXCEPT { return _buffer[_header->head]._value; }
+
+        reference back() JM_CB_NOEXCEPT
+        {
+            return _buffer[_wrapper.decrement(end_index())]._value;
+        }
+
+        const_reference back() const JM_CB_NOEXCEPT
+        {
+            return _buffer[_wrapper.decrement(end_index())]._value;
+        }
+
+        reference operator[](size_type pos) JM_CB_NOEXCEPT
+        {
+            return _buffer[_wrapper.advance(static_cast<std::size_t>(_header->head),
+                                            static_cast<difference_type>(pos))]
+                ._value;
+        }
+
+        const_reference operator[](size_type pos) const JM_CB_NOEXCEPT
+        {
+            return _buffer[_wrapper.advance(static_cast<std::size_t>(_header->head),
+                                            static_cast<difference_type>(pos))]
+                ._value;
+        }
+
+        iterator begin() JM_CB_NOEXCEPT
+        {
+            return iterator(_buffer, static_cast<std::size_t>(_header->head), size(), _wrapper);
+        }
+
+        const_iterator begin() const JM_CB_NOEXCEPT
+        {
+            return const_iterator(
+                _buffer, static_cast<std::size_t>(_header->head), size(), _wrapper);
+        }
+
+        iterator end() JM_CB_NOEXCEPT { return iterator(_buffer, end_index(), 0, _wrapper); }
+
+        const_iterator end() const JM_CB_NOEXCEPT
+        {
+            return const_iterator(_buffer, end_index(), 0, _wrapper);
+        }
+
+        const_iterator cbegin() const JM_CB_NOEXCEPT { return begin(); }
+        const_iterator cend() const JM_CB_NOEXCEPT { return end(); }
+
+        reverse_iterator       rbegin() JM_CB_NOEXCEPT { return reverse_iterator(end()); }
+        const_reverse_iterator rbegin() const JM_CB_NOEXCEPT
+        {
+            return const_reverse_iterator(end());
+        }
+        reverse_iterator       rend() JM_CB_NOEXCEPT { return reverse_iterator(begin()); }
+        const_reverse_iterator rend() const JM_CB_NOEXCEPT
+        {
+            return const_reverse_iterator(begin());
+        }
+
+        /// appends value, overwriting the front if the buffer is full. The front is
+        /// dropped from the header before its slot is reused so that a crash never
+        /// exposes a half written element.
+        void push_back(const T& value) JM_CB_NOEXCEPT
+        {
+            if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full()))
+                pop_front();
+
+            std::memcpy(JM_CB_ADDRESSOF(_buffer[end_index()]._value),
+                        JM_CB_ADDRESSOF(value),
+                        sizeof(T));
+            order_stores();
+            _header->size += 1;
+        }
+
+        // every prefix of the stores reopens to a valid buffer: first without the
+        // back, then without the front
+        void pop_front() JM_CB_NOEXCEPT
+        {
+            _header->size -= 1;
+            order_stores();
+            _header->head = _wrapper.increment(static_cast<std::size_t>(_header->head));
+            order_stores();
+        }
+
+        void pop_back() JM_CB_NOEXCEPT { _header->size -= 1; }
+
+        void clear() JM_CB_NOEXCEPT { _header->size = 0; }
+
+        /// calls f(first, last) with the pointer ranges of the at most two contiguous
+        /// segments that are not empty, in logical order. returns f like std::for_each.
+        template<class F>
+        F for_each_segment(F f) const
+        {
+            const detail::cb_segments<const T> s = begin().segments(end());
+            if(s.one_count != 0)
+                f(s.one, s.one + s.one_count);
+            if(s.two_count != 0)
+                f(s.two, s.two + s.two_count);
+
+            return f;
+        }
+
+        /// waits until the header and the elements in [first, last) are written to the
+        /// file. Throws std::system_error if msync fails.
+        void flush(const_iterator first, const_iterator last) const
+        {
+            const detail::cb_segments<const T> s = first.segments(last);
+            if(s.one_count != 0)
+                sync(s.one, s.one_count * sizeof(T));
+            if(s.two_count != 0)
+                sync(s.two, s.two_count * sizeof(T));
+
+            sync(_header, sizeof(*_header));
+        }
+
+        /// waits until the whole mapping is written to the file
+        void flush() const { sync(_map, _map_size); }
+    };
+
+} // namespace jm
+
+#endif // JM_MAPPED_CIRCULAR_BUFFER_HPP
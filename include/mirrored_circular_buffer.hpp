@@ -0,0 +1,344 @@
+/*
+ * Copyright 2017 Justas Masiulis
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JM_MIRRORED_CIRCULAR_BUFFER_HPP
+#define JM_MIRRORED_CIRCULAR_BUFFER_HPP
+
+#include "circular_buffer.hpp"
+#include <cerrno>
+#include <system_error>
+
+#if defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+#error "mirrored_circular_buffer requires c++11"
+#endif
+
+#if defined(_WIN32)
+#include <windows.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "onecore.lib") // VirtualAlloc2 and MapViewOfFile3
+#endif
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdio>
+#include <atomic>
+#else
+#error "mirrored_circular_buffer requires windows or a posix system"
+#endif
+
+namespace jm {
+
+    namespace detail {
+
+        // size bytes of memory mapped twice, back to back, so that [base, base + 2 * size)
+        // is valid and base[i + size] is base[i]. size has to be a multiple of
+        // granularity().
+        class cb_mirrored_mapping {
+            char*       _base;
+            std::size_t _size;
+
+#if defined(_WIN32)
+            static std::system_error error(const char* what)
+            {
+                return std::system_error(
+                    static_cast<int>(::GetLastError()), std::system_category(), what);
+            }
+
+            void map()
+            {
+                void* placeholder = ::VirtualAlloc2(JM_CB_NULLPTR,
+                                                    JM_CB_NULLPTR,
+                                                    2 * _size,
+                                                    MEM_RESERVE | MEM_RESERVE_PLACEHOLDER,
+                                                    PAGE_NOACCESS,
+                                                    JM_CB_NULLPTR,
+                                                    0);
+                if(placeholder == JM_CB_NULLPTR)
+                    throw error("VirtualAlloc2");
+
+                // split the placeholder so that each half can be replaced by a view
+                ::VirtualFree(placeholder, _size, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER);
+
+                const unsigned long long size = _size;
+                HANDLE section = ::CreateFileMappingW(INVALID_HANDLE_VALUE,
+                                                      JM_CB_NULLPTR,
+                                                      PAGE_READWRITE,
+                                                      static_cast<DWORD>(size >> 32),
+                                                      static_cast<DWORD>(size),
+                                                      JM_CB_NULLPTR);
+                if(section == JM_CB_NULLPTR) {
+                    const std::system_error e = error("CreateFileMapping");
+                    ::VirtualFree(placeholder, 0, MEM_RELEASE);
+                    ::VirtualFree(static_cast<char*>(placeholder) + _size, 0, MEM_RELEASE);
+                    throw e;
+                }
+
+                void* first = ::MapViewOfFile3(section, JM_CB_NULLPTR, placeholder, 0, _size,
+                                              MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE,
+                                              JM_CB_NULLPTR, 0);
+                void* second = (first == JM_CB_NULLPTR)
+                                   ? JM_CB_NULLPTR
+                                   : ::MapViewOfFile3(section, JM_CB_NULLPTR,
+                                                      static_cast<char*>(placeholder) + _size,
+                                                      0, _size, MEM_REPLACE_PLACEHOLDER,
+                                                      PAGE_READWRITE, JM_CB_NULLPTR, 0);
+                if(second == JM_CB_NULLPTR) {
+                    const std::system_error e = error("MapViewOfFile3");
+                    if(first != JM_CB_NULLPTR)
+                        ::UnmapViewOfFile(first);
+                    else
+                        ::VirtualFree(placeholder, 0, MEM_RELEASE);
+                    ::VirtualFree(static_cast<char*>(placeholder) + _size, 0, MEM_RELEASE);
+                    ::CloseHandle(section);
+                    throw e;
+                }
+
+                // the views keep the section alive
+                ::CloseHandle(section);
+                _base = static_cast<char*>(first);
+            }
+
+            void unmap() JM_CB_NOEXCEPT
+            {
+                ::UnmapViewOfFile(_base);
+                ::UnmapViewOfFile(_base + _size);
+            }
+
+        public:
+            static std::size_t granularity() JM_CB_NOEXCEPT
+            {
+                SYSTEM_INFO info;
+                ::GetSystemInfo(&info);
+                return info.dwAllocationGranularity;
+            }
+#else
+            static std::system_error error(const char* what)
+            {
+                return std::system_error(errno, std::generic_category(), what);
+            }
+
+            // anonymous memory that can be mapped more than once
+            static int open_memory()
+            {
+#if defined(__linux__)
+                const int fd = ::memfd_create("jm_mirrored_circular_buffer", MFD_CLOEXEC);
+                if(fd == -1)
+                    throw error("memfd_create");
+#else
+                // the name only exists until it is unlinked again. It is kept short
+                // because macOS limits names to 31 characters, a name left behind by a
+                // crashed process with the same pid is skipped.
+                static std::atomic<unsigned> counter(0);
+
+                int fd = -1;
+                for(int attempt = 0; fd == -1 && attempt < 16; ++attempt) {
+                    char name[32];
+                    std::snprintf(name, sizeof(name), "/jmcb%lx.%x",
+                                  static_cast<unsigned long>(::getpid()),
+                                  counter.fetch_add(1, std::memory_order_relaxed));
+                    fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+                    if(fd != -1)
+                        ::shm_unlink(name);
+                    else if(errno != EEXIST)
+                        break;
+                }
+                if(fd == -1)
+                    throw error("shm_open");
+#endif
+                return fd;
+            }
+
+            void map()
+            {
+                const int fd = open_memory();
+                if(::ftruncate(fd, static_cast<off_t>(_size)) != 0) {
+                    const std::system_error e = error("ftruncate");
+                    ::close(fd);
+                    throw e;
+                }
+
+                // reserve both halves first so that nothing else can end up in between
+                void* reserved = ::mmap(JM_CB_NULLPTR, 2 * _size, PROT_NONE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if(reserved == MAP_FAILED) {
+                    const std::system_error e = error("mmap");
+                    ::close(fd);
+                    throw e;
+                }
+
+                char* base = static_cast<char*>(reserved);
+                if(::mmap(base, _size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+                       MAP_FAILED ||
+                   ::mmap(base + _size, _size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                          fd, 0) == MAP_FAILED) {
+                    const std::system_error e = error("mmap");
+                    ::munmap(reserved, 2 * _size);
+                    ::close(fd);
+                    throw e;
+                }
+
+                // the mappings keep the memory alive
+                ::close(fd);
+                _base = base;
+            }
+
+            void unmap() JM_CB_NOEXCEPT { ::munmap(_base, 2 * _size); }
+
+        public:
+            static std::size_t granularity() JM_CB_NOEXCEPT
+            {
+                return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            }
+#endif
+            explicit cb_mirrored_mapping(std::size_t size) : _base(JM_CB_NULLPTR), _size(size)
+            {
+                map();
+            }
+
+            cb_mirrored_mapping(const cb_mirrored_mapping&) = delete;
+            cb_mirrored_mapping& operator=(const cb_mirrored_mapping&) = delete;
+
+            ~cb_mirrored_mapping() { unmap(); }
+
+            char*       data() const JM_CB_NOEXCEPT { return _base; }
+            std::size_t size() const JM_CB_NOEXCEPT { return _size; }
+        };
+
+    } // namespace detail
+
+    /// ring of trivially copyable elements, usually bytes, whose memory is mapped twice
+    /// back to back. Any range of up to capacity() elements starting at any element is
+    /// therefore contiguous, so the contents can always be read through data() and the
+    /// free space written through write_data() as plain arrays.
+    /// Unlike circular_buffer it does not overwrite the front once full.
+    template<typename T = unsigned char>
+    class mirrored_circular_buffer {
+    public:
+        typedef T              value_type;
+        typedef std::size_t    size_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T&             reference;
+        typedef const T&       const_reference;
+        typedef T*             pointer;
+        typedef const T*       const_pointer;
+        typedef T*             iterator;
+        typedef const T*       const_iterator;
+
+        static_assert(JM_CB_IS_TRIVIALLY_COPYABLE(T),
+                      "mirrored_circular_buffer requires trivially copyable elements");
+
+    private:
+        typedef detail::cb_copier<T> copier_t;
+
+        detail::cb_mirrored_mapping _mapping;
+        size_type                   _head;
+        size_type                   _size;
+
+        // the mapping has to consist of whole pages and hold whole elements
+        static size_type mapping_size(size_type min_capacity)
+        {
+            const size_type granularity = detail::cb_mirrored_mapping::granularity();
+            if(granularity % sizeof(T) != 0)
+                throw std::invalid_argument(
+                    "mirrored_circular_buffer: element size does not divide the page size");
+
+            const size_type bytes = (min_capacity == 0 ? 1 : min_capacity) * sizeof(T);
+            return (bytes + granularity - 1) / granularity * granularity;
+        }
+
+        pointer slots() const JM_CB_NOEXCEPT { return reinterpret_cast<pointer>(_mapping.data()); }
+
+    public:
+        /// capacity() is min_capacity rounded up to fill whole pages.
+        /// Throws std::system_error if the memory can not be mapped.
+        explicit mirrored_circular_buffer(size_type min_capacity)
+            : _mapping(mapping_size(min_capacity)), _head(0), _size(0)
+        {}
+
+        mirrored_circular_buffer(const mirrored_circular_buffer&) = delete;
+        mirrored_circular_buffer& operator=(const mirrored_circular_buffer&) = delete;
+
+        /// capacity
+        bool      empty() const JM_CB_NOEXCEPT { return _size == 0; }
+        bool      full() const JM_CB_NOEXCEPT { return _size == capacity(); }
+        size_type size() const JM_CB_NOEXCEPT { return _size; }
+        size_type capacity() const JM_CB_NOEXCEPT { return _mapping.size() / sizeof(T); }
+
+        /// number of elements that can be written before the buffer is full
+        size_type available() const JM_CB_NOEXCEPT { return capacity() - _size; }
+
+        /// element access, [data(), data() + size()) is always contiguous
+        pointer       data() JM_CB_NOEXCEPT { return slots() + _head; }
+        const_pointer data() const JM_CB_NOEXCEPT { return slots() + _head; }
+
+        reference       front() JM_CB_NOEXCEPT { return data()[0]; }
+        const_reference front() const JM_CB_NOEXCEPT { return data()[0]; }
+        reference       back() JM_CB_NOEXCEPT { return data()[_size - 1]; }
+        const_reference back() const JM_CB_NOEXCEPT { return data()[_size - 1]; }
+
+        reference       operator[](size_type pos) JM_CB_NOEXCEPT { return data()[pos]; }
+        const_reference operator[](size_type pos) const JM_CB_NOEXCEPT { return data()[pos]; }
+
+        iterator       begin() JM_CB_NOEXCEPT { return data(); }
+        const_iterator begin() const JM_CB_NOEXCEPT { return data(); }
+        const_iterator cbegin() const JM_CB_NOEXCEPT { return data(); }
+        iterator       end() JM_CB_NOEXCEPT { return data() + _size; }
+        const_iterator end() const JM_CB_NOEXCEPT { return data() + _size; }
+        const_iterator cend() const JM_CB_NOEXCEPT { return data() + _size; }
+
+        /// modifiers
+        /// [write_data(), write_data() + available()) is the contiguous free space,
+        /// elements written to it are appended by commit
+        pointer write_data() JM_CB_NOEXCEPT { return data() + _size; }
+
+        /// appends the first count elements of the free space, count <= available()
+        void commit(size_type count) JM_CB_NOEXCEPT { _size += count; }
+
+        /// appends up to count elements from src and returns how many were appended
+        size_type try_push(const_pointer src, size_type count) JM_CB_NOEXCEPT
+        {
+            if(count > available())
+                count = available();
+
+            copier_t::copy_n(src, count, write_data());
+            commit(count);
+            return count;
+        }
+
+        bool try_push(const_reference value) JM_CB_NOEXCEPT { return try_push(&value, 1) == 1; }
+
+        /// removes count elements from the front, count <= size()
+        void pop_front(size_type count = 1) JM_CB_NOEXCEPT
+        {
+            _head += count;
+            if(_head >= capacity())
+                _head -= capacity();
+            _size -= count;
+        }
+
+        void pop_back(size_type count = 1) JM_CB_NOEXCEPT { _size -= count; }
+
+        void clear() JM_CB_NOEXCEPT
+        {
+            _head = 0;
+            _size = 0;
+        }
+    };
+
+} // namespace jm
+
+#endif // JM_MIRRORED_CIRCULAR_BUFFER_HPP
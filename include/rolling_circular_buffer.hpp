@@ -0,0 +1,474 @@
+/*
+ * Copyright 2017 Justas Masiulis
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JM_ROLLING_CIRCULAR_BUFFER_HPP
+#define JM_ROLLING_CIRCULAR_BUFFER_HPP
+
+#include "circular_buffer.hpp"
+#include <functional>
+#include <cstdint>
+#include <cmath>
+
+#if defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+#error "rolling_circular_buffer requires c++11"
+#endif
+
+namespace jm {
+
+    // aggregators are templates of the element type and capacity. They are bases of
+    // rolling_circular_buffer, so their queries are available on the buffer itself.
+    // The hooks are called with the element that enters or leaves the window:
+    //   on_push(const T&)  after an element was appended
+    //   on_evict(const T&) before the front element is removed or overwritten
+    //   on_clear()         after every element was removed
+
+    /// running sum
+    template<class T, std::size_t N>
+    class rolling_sum {
+        T _sum;
+
+    protected:
+        rolling_sum() : _sum() {}
+
+        void on_push(const T& value) { _sum += value; }
+        void on_evict(const T& value) { _sum -= value; }
+        void on_clear() { _sum = T(); }
+
+    public:
+        const T& sum() const noexcept { return _sum; }
+    };
+
+    /// running count, sum and sum of squares.
+    /// floating point values accumulate rounding errors as they enter and leave the
+    /// window, recompute from the contents periodically if that matters.
+    template<class T, std::size_t N>
+    class rolling_moments {
+        std::size_t _count;
+        T           _sum;
+        T           _sum_of_squares;
+
+    protected:
+        rolling_moments() : _count(0), _sum(), _sum_of_squares() {}
+
+        void on_push(const T& value)
+        {
+            ++_count;
+            _sum += value;
+            _sum_of_squares += value * value;
+        }
+
+        void on_evict(const T& value)
+        {
+            --_count;
+            _sum -= value;
+            _sum_of_squares -= value * value;
+        }
+
+        void on_clear()
+        {
+            _count          = 0;
+            _sum            = T();
+            _sum_of_squares = T();
+        }
+
+    public:
+        std::size_t count() const noexcept { return _count; }
+        const T&    sum() const noexcept { return _sum; }
+        const T&    sum_of_squares() const noexcept { return _sum_of_squares; }
+
+        /// the window must not be empty
+        T mean() const { return _sum / static_cast<T>(_count); }
+
+        /// population variance, the window must not be empty
+        T variance() const
+        {
+            const T m = mean();
+            return _sum_of_squares / static_cast<T>(_count) - m * m;
+        }
+    };
+
+    namespace detail {
+
+        // monotonic deque of the candidates for the extreme of the window, stored in
+        // a circular_buffer since there are never more candidates than elements.
+        // Compare(a, b) is true if a replaces b as the extreme.
+        template<class T, std::size_t N, class Compare>
+        class cb_rolling_extreme {
+            circular_buffer<T, N> _candidates;
+
+        protected:
+            void on_push(const T& value)
+            {
+                while(!_candidates.empty() && Compare()(value, _candidates.back()))
+                    _candidates.pop_back();
+
+                _candidates.push_back(value);
+            }
+
+            // the front candidate is the extreme, so it is the evicted element unless
+            // that one already got replaced
+            void on_evict(const T& value)
+            {
+                if(!Compare()(_candidates.front(), value))
+                    _candidates.pop_front();
+            }
+
+            void on_clear() { _candidates.clear(); }
+
+            const T& extreme() const noexcept { return _candidates.front(); }
+        };
+
+        template<class T>
+        struct cb_greater {
+            bool operator()(const T& lhs, const T& rhs) const { return rhs < lhs; }
+        };
+
+    } // namespace detail
+
+    /// sliding minimum in amortized O(1)
+    template<class T, std::size_t N>
+    class rolling_min : private detail::cb_rolling_extreme<T, N, std::less<T>> {
+        typedef detail::cb_rolling_extreme<T, N, std::less<T>> base_type;
+
+    protected:
+        using base_type::on_push;
+        using base_type::on_evict;
+        using base_type::on_clear;
+
+    public:
+        /// the window must not be empty
+        const T& min() const noexcept { return this->extreme(); }
+    };
+
+    /// sliding maximum in amortized O(1)
+    template<class T, std::size_t N>
+    class rolling_max : private detail::cb_rolling_extreme<T, N, detail::cb_greater<T>> {
+        typedef detail::cb_rolling_extreme<T, N, detail::cb_greater<T>> base_type;
+
+    protected:
+        using base_type::on_push;
+        using base_type::on_evict;
+        using base_type::on_clear;
+
+    public:
+        /// the window must not be empty
+        const T& max() const noexcept { return this->extreme(); }
+    };
+
+    /// order statistics of the window in expected O(log N), e.g. latency percentiles.
+    /// The values are also kept in a treap ordered by operator<, whose nodes live in
+    /// a pool of N so nothing is allocated. T has to be default constructible.
+    template<class T, std::size_t N>
+    class rolling_order_statistics {
+        typedef typename detail::cb_index_type<N>::type index_type;
+
+        // N is never a node, so it marks the missing children
+        struct node {
+            T             value;
+            std::uint32_t priority;
+            index_type    left;
+            index_type    right;
+            index_type    size;
+        };
+
+        node          _nodes[N];
+        index_type    _root;
+        index_type    _free; // free nodes are linked through left
+        std::uint32_t _seed;
+
+        static index_type nil() noexcept { return static_cast<index_type>(N); }
+
+        std::size_t size_of(index_type t) const noexcept
+        {
+            return (t == nil()) ? 0 : _nodes[t].size;
+        }
+
+        void update(index_type t) noexcept
+        {
+            _nodes[t].size =
+                static_cast<index_type>(size_of(_nodes[t].left) + size_of(_nodes[t].right) + 1);
+        }
+
+        // xorshift, the priorities only have to be unrelated to the values
+        std::uint32_t next_priority() noexcept
+        {
+            _seed ^= _seed << 13;
+            _seed ^= _seed >> 17;
+            _seed ^= _seed << 5;
+            return _seed;
+        }
+
+        // splits t into the values less than value and the rest
+        void split(index_type t, const T& value, index_type& less, index_type& rest) noexcept
+        {
+            if(t == nil()) {
+                less = rest = nil();
+                return;
+            }
+
+            if(_nodes[t].value < value) {
+                split(_nodes[t].right, value, _nodes[t].right, rest);
+                less = t;
+            }
+            else {
+                split(_nodes[t].left, value, less, _nodes[t].left);
+                rest = t;
+            }
+
+            update(t);
+        }
+
+        // every value in less has to be ordered before the ones in rest
+        index_type merge(index_type less, index_type rest) noexcept
+        {
+            if(less == nil())
+                return rest;
+            if(rest == nil())
+                return less;
+
+            if(_nodes[less].priority > _nodes[rest].priority) {
+                _nodes[less].right = merge(_nodes[less].right, rest);
+                update(less);
+                return less;
+            }
+
+            _nodes[rest].left = merge(less, _nodes[rest].left);
+            update(rest);
+            return rest;
+        }
+
+        index_type insert(index_type t, index_type n) noexcept
+        {
+            if(t == nil())
+                return n;
+
+            if(_nodes[n].priority > _nodes[t].priority) {
+                split(t, _nodes[n].value, _nodes[n].left, _nodes[n].right);
+                update(n);
+                return n;
+            }
+
+            if(_nodes[n].value < _nodes[t].value)
+                _nodes[t].left = insert(_nodes[t].left, n);
+            else
+                _nodes[t].right = insert(_nodes[t].right, n);
+
+            update(t);
+            return t;
+        }
+
+        // removes one node holding a value equivalent to value, which has to exist
+        index_type erase(index_type t, const T& value) noexcept
+        {
+            if(value < _nodes[t].value)
+                _nodes[t].left = erase(_nodes[t].left, value);
+            else if(_nodes[t].value < value)
+                _nodes[t].right = erase(_nodes[t].right, value);
+            else {
+                const index_type replacement = merge(_nodes[t].left, _nodes[t].right);
+                _nodes[t].left               = _free;
+                _free                        = t;
+                return replacement;
+            }
+
+            update(t);
+            return t;
+        }
+
+    protected:
+        rolling_order_statistics() : _nodes(), _seed(0x9E3779B9u) { on_clear(); }
+
+        void on_push(const T& value)
+        {
+            const index_type n = _free;
+            _free              = _nodes[n].left;
+
+            _nodes[n].value    = value;
+            _nodes[n].priority = next_priority();
+            _nodes[n].left     = nil();
+            _nodes[n].right    = nil();
+            _nodes[n].size     = 1;
+            _root              = insert(_root, n);
+        }
+
+        void on_evict(const T& value) { _root = erase(_root, value); }
+
+        void on_clear() noexcept
+        {
+            _root = nil();
+            _free = 0;
+            for(std::size_t i = 0; i < N; ++i)
+                _nodes[i].left = static_cast<index_type>(i + 1);
+        }
+
+    public:
+        /// number of values in the window that are less than value
+        std::size_t rank(const T& value) const noexcept
+        {
+            std::size_t less = 0;
+            for(index_type t = _root; t != nil();) {
+                if(_nodes[t].value < value) {
+                    less += size_of(_nodes[t].left) + 1;
+                    t = _nodes[t].right;
+                }
+                else
+                    t = _nodes[t].left;
+            }
+
+            return less;
+        }
+
+        /// the value at position k of the sorted window, k has to be less than its size
+        const T& select(std::size_t k) const noexcept
+        {
+            index_type t = _root;
+            for(;;) {
+                const std::size_t left = size_of(_nodes[t].left);
+                if(k == left)
+                    return _nodes[t].value;
+
+                if(k < left)
+                    t = _nodes[t].left;
+                else {
+                    k -= left + 1;
+                    t = _nodes[t].right;
+                }
+            }
+        }
+
+        /// smallest value that at least q of the window is less than or equal to,
+        /// e.g. quantile(0.99) is the p99. The window must not be empty.
+        const T& quantile(double q) const noexcept
+        {
+            const std::size_t count = size_of(_root);
+            const double      pos   = std::ceil(q * static_cast<double>(count));
+
+            if(pos <= 1.)
+                return select(0);
+            if(pos >= static_cast<double>(count))
+                return select(count - 1);
+
+            return select(static_cast<std::size_t>(pos) - 1);
+        }
+    };
+
+    /// circular_buffer used as a sliding window that keeps the Aggregators up to date
+    /// while elements are pushed and evicted. Elements can only be modified through
+    /// the window operations so that the aggregates stay consistent, which also
+    /// requires that copying or moving T into the window does not throw.
+    template<class T, std::size_t N, template<class, std::size_t> class... Aggregators>
+    class rolling_circular_buffer : public Aggregators<T, N>... {
+        typedef circular_buffer<T, N> buffer_type;
+
+        buffer_type _buffer;
+
+        void notify_push(const T& value)
+        {
+            const int expand[] = {0, (this->Aggregators<T, N>::on_push(value), 0)...};
+            (void)expand;
+        }
+
+        void notify_evict(const T& value)
+        {
+            const int expand[] = {0, (this->Aggregators<T, N>::on_evict(value), 0)...};
+            (void)expand;
+        }
+
+        void notify_clear()
+        {
+            const int expand[] = {0, (this->Aggregators<T, N>::on_clear(), 0)...};
+            (void)expand;
+        }
+
+    public:
+        typedef typename buffer_type::value_type      value_type;
+        typedef typename buffer_type::size_type       size_type;
+        typedef typename buffer_type::const_reference const_reference;
+        typedef typename buffer_type::const_iterator  const_iterator;
+
+        rolling_circular_buffer() = default;
+
+        template<class InputIt>
+        rolling_circular_buffer(InputIt first, InputIt last)
+        {
+            for(; first != last; ++first)
+                push_back(*first);
+        }
+
+        rolling_circular_buffer(std::initializer_list<T> init)
+            : rolling_circular_buffer(init.begin(), init.end())
+        {}
+
+        /// the underlying buffer for read only access, e.g. to jm::cb algorithms
+        const buffer_type& buffer() const noexcept { return _buffer; }
+
+        bool      empty() const noexcept { return _buffer.empty(); }
+        bool      full() const noexcept { return _buffer.full(); }
+        size_type size() const noexcept { return _buffer.size(); }
+        constexpr size_type capacity() const noexcept { return N; }
+
+        const_reference front() const noexcept { return _buffer.front(); }
+        const_reference back() const noexcept { return _buffer.back(); }
+        const_reference operator[](size_type pos) const noexcept { return _buffer[pos]; }
+
+        const_iterator begin() const noexcept { return _buffer.begin(); }
+        const_iterator end() const noexcept { return _buffer.end(); }
+
+        /// appends value, evicting the front first if the window is full
+        void push_back(const T& value)
+        {
+            if(_buffer.full())
+                notify_evict(_buffer.front());
+
+            _buffer.push_back(value);
+            notify_push(_buffer.back());
+        }
+
+        void push_back(T&& value)
+        {
+            if(_buffer.full())
+                notify_evict(_buffer.front());
+
+            _buffer.push_back(std::move(value));
+            notify_push(_buffer.back());
+        }
+
+        template<class... Args>
+        void emplace_back(Args&&... args)
+        {
+            if(_buffer.full())
+                notify_evict(_buffer.front());
+
+            _buffer.emplace_back(std::forward<Args>(args)...);
+            notify_push(_buffer.back());
+        }
+
+        void pop_front()
+        {
+            notify_evict(_buffer.front());
+            _buffer.pop_front();
+        }
+
+        void clear()
+        {
+            _buffer.clear();
+            notify_clear();
+        }
+    };
+
+} // namespace jm
+
+#endif // JM_ROLLING_CIRCULAR_BUFFER_HPP
@@ -0,0 +1,333 @@
+/*
+ * Copyright 2017 Justas Masiulis
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JM_SERIALIZED_CIRCULAR_BUFFER_HPP
+#define JM_SERIALIZED_CIRCULAR_BUFFER_HPP
+
+#include "circular_buffer.hpp"
+#include <cstdint>
+
+#if defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+#error "serialized_circular_buffer requires c++11"
+#endif
+
+namespace jm {
+
+    namespace detail {
+
+        // first bytes of a snapshot, followed by the elements in logical order. Like
+        // the mapped files it is in the native byte order and only meant to be read
+        // back on the same kind of machine.
+        struct cb_snapshot_header {
+            char          magic[4];
+            std::uint32_t element_size;
+            std::uint64_t capacity;
+            std::uint64_t size;
+        };
+
+        static const char cb_snapshot_magic[4] = {'j', 'm', 's', 1 /* version */};
+
+        // the elements start on an alignof(T) boundary after the header and every
+        // snapshot is padded to the alignment of both, so snapshots written back to
+        // back can all be viewed in place
+        template<class T>
+        struct cb_snapshot_layout {
+            static const std::size_t alignment = (alignof(T) > alignof(cb_snapshot_header))
+                                                     ? alignof(T)
+                                                     : alignof(cb_snapshot_header);
+
+            static const std::size_t elements_offset =
+                (sizeof(cb_snapshot_header) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+            static std::size_t snapshot_size(std::size_t count) JM_CB_NOEXCEPT
+            {
+                return (elements_offset + count * sizeof(T) + alignment - 1) / alignment *
+                       alignment;
+            }
+        };
+
+        // reads and checks the header at in, available is the number of readable bytes
+        template<class T>
+        cb_snapshot_header cb_read_snapshot_header(const void* in, std::size_t available)
+        {
+            typedef cb_snapshot_layout<T> layout_type;
+
+            cb_snapshot_header header;
+            if(available < sizeof(header))
+                throw std::runtime_error("circular_buffer snapshot: truncated header");
+
+            std::memcpy(&header, in, sizeof(header));
+            if(std::memcmp(header.magic, cb_snapshot_magic, sizeof(header.magic)) != 0)
+                throw std::runtime_error("circular_buffer snapshot: not a snapshot");
+            if(header.element_size != sizeof(T))
+                throw std::runtime_error("circular_buffer snapshot: element type mismatch");
+            if(header.size > header.capacity)
+                throw std::runtime_error("circular_buffer snapshot: corrupted size");
+            if(available < layout_type::elements_offset ||
+               header.size > (available - layout_type::elements_offset) / sizeof(T) ||
+               available < layout_type::snapshot_size(static_cast<std::size_t>(header.size)))
+                throw std::runtime_error("circular_buffer snapshot: truncated elements");
+
+            return header;
+        }
+
+        template<class Buffer>
+        std::size_t cb_serialize(const Buffer& buffer, void* out) JM_CB_NOEXCEPT
+        {
+            typedef typename Buffer::value_type T;
+            typedef cb_snapshot_layout<T>       layout_type;
+
+            static_assert(JM_CB_IS_TRIVIALLY_COPYABLE(T),
+                          "serialization requires trivially copyable elements");
+
+            cb_snapshot_header header;
+            std::memcpy(header.magic, cb_snapshot_magic, sizeof(header.magic));
+            header.element_size = sizeof(T);
+            header.capacity     = buffer.capacity();
+            header.size         = buffer.size();
+
+            char* const       bytes = static_cast<char*>(out);
+            const std::size_t total = layout_type::snapshot_size(buffer.size());
+            std::memcpy(bytes, &header, sizeof(header));
+            std::memset(bytes + sizeof(header), 0, layout_type::elements_offset - sizeof(header));
+
+            char* dest = bytes + layout_type::elements_offset;
+            buffer.for_each_segment([&dest](const T* first, const T* last) {
+                const std::size_t length = static_cast<std::size_t>(last - first) * sizeof(T);
+                std::memcpy(dest, first, length);
+                dest += length;
+            });
+            std::memset(dest, 0, static_cast<std::size_t>(bytes + total - dest));
+
+            return total;
+        }
+
+        // replaces the contents with the count elements at src through the free slots
+        template<class Buffer>
+        void cb_restore(Buffer& buffer, const char* src, std::size_t count) JM_CB_NOEXCEPT
+        {
+            typedef typename Buffer::value_type  T;
+            typedef typename Buffer::array_range range_type;
+
+            buffer.clear();
+            if(count == 0)
+                return;
+
+            const range_type one = buffer.free_array_one();
+            const range_type two = buffer.free_array_two();
+            const std::size_t first_count = (count < one.second) ? count : one.second;
+            std::memcpy(one.first, src, first_count * sizeof(T));
+            std::memcpy(two.first, src + first_count * sizeof(T), (count - first_count) * sizeof(T));
+            buffer.commit_back(count);
+        }
+
+    } // namespace detail
+
+    /// read only circular buffer over a snapshot written by serialize(), for example
+    /// one in a mapped file. Nothing is copied, so the bytes have to outlive the view
+    /// and start on an alignof(T) boundary. The elements of a snapshot are stored in
+    /// logical order, so array_two() is always empty.
+    template<class T>
+    class circular_buffer_view {
+        typedef detail::cb_snapshot_layout<T> layout_type;
+
+        static_assert(JM_CB_IS_TRIVIALLY_COPYABLE(T),
+                      "circular_buffer_view requires trivially copyable elements");
+
+        const T*    _data;
+        std::size_t _size;
+        std::size_t _capacity;
+
+    public:
+        typedef T                                     value_type;
+        typedef std::size_t                           size_type;
+        typedef std::ptrdiff_t                        difference_type;
+        typedef const T&                              reference;
+        typedef const T&                              const_reference;
+        typedef const T*                              pointer;
+        typedef const T*                              const_pointer;
+        typedef const T*                              iterator;
+        typedef const T*                              const_iterator;
+        typedef std::reverse_iterator<const_iterator> reverse_iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+        typedef std::pair<const_pointer, size_type>   array_range;
+        typedef std::pair<const_pointer, size_type>   const_array_range;
+
+        /// an empty view with no capacity
+        circular_buffer_view() JM_CB_NOEXCEPT : _data(JM_CB_NULLPTR), _size(0), _capacity(0) {}
+
+        /// views the snapshot at data, available is the number of readable bytes.
+        /// Throws std::runtime_error if they do not hold a whole snapshot of T or data
+        /// is misaligned.
+        circular_buffer_view(const void* data, size_type available)
+        {
+            const detail::cb_snapshot_header header =
+                detail::cb_read_snapshot_header<T>(data, available);
+            if(reinterpret_cast<std::uintptr_t>(data) % alignof(T) != 0)
+                throw std::runtime_error("circular_buffer snapshot: misaligned for viewing");
+
+            _data     = reinterpret_cast<const T*>(static_cast<const char*>(data) +
+                                               layout_type::elements_offset);
+            _size     = static_cast<size_type>(header.size);
+            _capacity = static_cast<size_type>(header.capacity);
+        }
+
+        /// capacity
+        bool      empty() const JM_CB_NOEXCEPT { return _size == 0; }
+        bool      full() const JM_CB_NOEXCEPT { return _size == _capacity; }
+        size_type size() const JM_CB_NOEXCEPT { return _size; }
+        size_type max_size() const JM_CB_NOEXCEPT { return _capacity; }
+        size_type capacity() const JM_CB_NOEXCEPT { return _capacity; }
+
+        /// bytes taken by the snapshot, the next one of a sequence starts after them
+        size_type serialized_size() const JM_CB_NOEXCEPT
+        {
+            return layout_type::snapshot_size(_size);
+        }
+
+        /// element access
+        const_reference front() const JM_CB_NOEXCEPT { return _data[0]; }
+        const_reference back() const JM_CB_NOEXCEPT { return _data[_size - 1]; }
+        const_reference operator[](size_type pos) const JM_CB_NOEXCEPT { return _data[pos]; }
+
+        const_reference at(size_type pos) const
+        {
+            if(JM_CB_UNLIKELY(pos >= _size))
+                throw std::out_of_range("circular_buffer_view<T>::at(size_type pos) pos >= size()");
+
+            return _data[pos];
+        }
+
+        /// contiguous segments
+        const_array_range array_one() const JM_CB_NOEXCEPT
+        {
+            return const_array_range(_data, _size);
+        }
+
+        const_array_range array_two() const JM_CB_NOEXCEPT
+        {
+            return const_array_range(_data + _size, 0);
+        }
+
+        template<class F>
+        F for_each_segment(F f) const
+        {
+            if(_size != 0)
+                f(_data, _data + _size);
+
+            return f;
+        }
+
+        /// iterators
+        const_iterator         begin() const JM_CB_NOEXCEPT { return _data; }
+        const_iterator         end() const JM_CB_NOEXCEPT { return _data + _size; }
+        const_iterator         cbegin() const JM_CB_NOEXCEPT { return begin(); }
+        const_iterator         cend() const JM_CB_NOEXCEPT { return end(); }
+        const_reverse_iterator rbegin() const JM_CB_NOEXCEPT { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const JM_CB_NOEXCEPT { return const_reverse_iterator(begin()); }
+        const_reverse_iterator crbegin() const JM_CB_NOEXCEPT { return rbegin(); }
+        const_reverse_iterator crend() const JM_CB_NOEXCEPT { return rend(); }
+    };
+
+    /// number of bytes serialize(buffer, out) writes
+    template<class T, std::size_t N, std::size_t Alignment, class Streaming>
+    std::size_t serialized_size(const circular_buffer<T, N, Alignment, Streaming>& buffer) JM_CB_NOEXCEPT
+    {
+        return detail::cb_snapshot_layout<T>::snapshot_size(buffer.size());
+    }
+
+    template<class T, class Allocator>
+    std::size_t serialized_size(const dynamic_circular_buffer<T, Allocator>& buffer) JM_CB_NOEXCEPT
+    {
+        return detail::cb_snapshot_layout<T>::snapshot_size(buffer.size());
+    }
+
+    /// writes the capacity, the size and the elements in logical order to out, which
+    /// has room for serialized_size(buffer) bytes. Returns that number of bytes, it is
+    /// a multiple of the alignment of the snapshots so they can be written back to
+    /// back. The padding is zeroed so equal buffers give equal bytes.
+    template<class T, std::size_t N, std::size_t Alignment, class Streaming>
+    std::size_t serialize(const circular_buffer<T, N, Alignment, Streaming>& buffer,
+                          void* out) JM_CB_NOEXCEPT
+    {
+        return detail::cb_serialize(buffer, out);
+    }
+
+    template<class T, class Allocator>
+    std::size_t serialize(const dynamic_circular_buffer<T, Allocator>& buffer, void* out) JM_CB_NOEXCEPT
+    {
+        return detail::cb_serialize(buffer, out);
+    }
+
+    /// replaces the contents of buffer with the snapshot at in, available is the number
+    /// of readable bytes, which need no particular alignment. Returns the bytes the
+    /// snapshot took. Throws std::runtime_error if they do not hold a whole snapshot
+    /// of T with the capacity N, the buffer is unchanged then.
+    template<class T, std::size_t N, std::size_t Alignment, class Streaming>
+    std::size_t deserialize(circular_buffer<T, N, Alignment, Streaming>& buffer,
+                            const void*                                  in,
+                            std::size_t                                  available)
+    {
+        static_assert(JM_CB_IS_TRIVIALLY_COPYABLE(T),
+                      "serialization requires trivially copyable elements");
+
+        const detail::cb_snapshot_header header =
+            detail::cb_read_snapshot_header<T>(in, available);
+        if(header.capacity != N)
+            throw std::runtime_error("circular_buffer snapshot: capacity mismatch");
+
+        const std::size_t count = static_cast<std::size_t>(header.size);
+        detail::cb_restore(buffer,
+                           static_cast<const char*>(in) +
+                               detail::cb_snapshot_layout<T>::elements_offset,
+                           count);
+        return detail::cb_snapshot_layout<T>::snapshot_size(count);
+    }
+
+    /// the capacity of buffer is set to the one of the snapshot. Also throws
+    /// std::runtime_error if that capacity can not be allocated, the buffer is
+    /// unchanged whenever an exception is thrown.
+    template<class T, class Allocator>
+    std::size_t deserialize(dynamic_circular_buffer<T, Allocator>& buffer,
+                            const void*                            in,
+                            std::size_t                            available)
+    {
+        static_assert(JM_CB_IS_TRIVIALLY_COPYABLE(T),
+                      "serialization requires trivially copyable elements");
+
+        // checks the size against available before anything is allocated
+        const detail::cb_snapshot_header header =
+            detail::cb_read_snapshot_header<T>(in, available);
+
+        // the allocator limit also keeps the capacity within size_t
+        const Allocator allocator = buffer.get_allocator();
+        if(header.capacity > std::allocator_traits<Allocator>::max_size(allocator))
+            throw std::runtime_error("circular_buffer snapshot: capacity too large");
+
+        const std::size_t                     count = static_cast<std::size_t>(header.size);
+        dynamic_circular_buffer<T, Allocator> restored(
+            static_cast<std::size_t>(header.capacity), allocator);
+        detail::cb_restore(restored,
+                           static_cast<const char*>(in) +
+                               detail::cb_snapshot_layout<T>::elements_offset,
+                           count);
+        buffer.swap(restored);
+        return detail::cb_snapshot_layout<T>::snapshot_size(count);
+    }
+
+} // namespace jm
+
+#endif // JM_SERIALIZED_CIRCULAR_BUFFER_HPP
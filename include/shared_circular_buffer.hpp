@@ -0,0 +1,422 @@
+/*
+ * Copyright 2017 Justas Masiulis
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JM_SHARED_CIRCULAR_BUFFER_HPP
+#define JM_SHARED_CIRCULAR_BUFFER_HPP
+
+#include "circular_buffer.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#if defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+#error "shared_circular_buffer requires c++11"
+#endif
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "shared_circular_buffer requires a posix system"
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace jm {
+
+    namespace detail {
+
+        typedef std::atomic<std::uint32_t> cb_shared_position;
+
+        static_assert(ATOMIC_INT_LOCK_FREE == 2,
+                      "positions have to be lock free to be shared between processes");
+
+        // lives at the start of the shared memory. Only offsets are stored so that
+        // every process may map the memory at a different address.
+        struct cb_shared_header {
+            char          magic[8];
+            std::uint32_t version;
+            std::uint32_t element_size;
+            std::uint32_t capacity;
+            std::uint32_t reserved;
+
+            // producer
+            alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) cb_shared_position tail;
+            cb_shared_position producer_waiting;
+
+            // consumer
+            alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) cb_shared_position head;
+            cb_shared_position consumer_waiting;
+        };
+
+        static const char          cb_shared_magic[8] = {'j', 'm', 'c', 'b', 's', 'h', 'm', 0};
+        static const std::uint32_t cb_shared_version  = 1;
+
+        inline std::system_error cb_shared_error(const char* what)
+        {
+            return std::system_error(errno, std::generic_category(), what);
+        }
+
+    } // namespace detail
+
+#if defined(__linux__)
+
+    /// sleeps on the position with a process shared futex. The ring only issues the
+    /// wake up syscall when the other side announced that it is going to sleep.
+    struct futex_wait {
+        static void wait(const detail::cb_shared_position& position, std::uint32_t old) noexcept
+        {
+            ::syscall(SYS_futex, &position, FUTEX_WAIT, old, JM_CB_NULLPTR, JM_CB_NULLPTR, 0);
+        }
+
+        static void notify(detail::cb_shared_position& position) noexcept
+        {
+            ::syscall(SYS_futex, &position, FUTEX_WAKE, INT_MAX, JM_CB_NULLPTR, JM_CB_NULLPTR, 0);
+        }
+    };
+
+    static_assert(sizeof(detail::cb_shared_position) == sizeof(std::uint32_t),
+                  "futex_wait requires positions the size of a futex");
+
+#endif // defined(__linux__)
+
+    /// shm_open or file descriptor backed memory mapped into this process.
+    /// Throws std::system_error if it can not be opened or mapped.
+    class shared_memory {
+        int         _fd;
+        void*       _data;
+        std::size_t _size;
+
+        void map()
+        {
+            _data = ::mmap(JM_CB_NULLPTR, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+            if(_data == MAP_FAILED) {
+                _data = JM_CB_NULLPTR;
+                close();
+                throw detail::cb_shared_error("mmap");
+            }
+        }
+
+        void close() noexcept
+        {
+            if(_data != JM_CB_NULLPTR)
+                ::munmap(_data, _size);
+            if(_fd != -1)
+                ::close(_fd);
+        }
+
+    public:
+        /// opens the shm_open object called name, creating it with size bytes if it
+        /// does not exist yet
+        shared_memory(const char* name, std::size_t size)
+            : _fd(::shm_open(name, O_RDWR | O_CREAT, 0600)), _data(JM_CB_NULLPTR), _size(size)
+        {
+            if(_fd == -1)
+                throw detail::cb_shared_error("shm_open");
+
+            struct stat info;
+            if(::fstat(_fd, &info) != 0 ||
+               (info.st_size == 0 && ::ftruncate(_fd, static_cast<off_t>(size)) != 0)) {
+                const int error = errno;
+                close();
+                throw std::system_error(error, std::generic_category(), "shm_open");
+            }
+
+            if(info.st_size != 0)
+                _size = static_cast<std::size_t>(info.st_size);
+
+            map();
+        }
+
+        /// maps all of the memory behind fd, for example a memfd received from another
+        /// process, and takes ownership of the descriptor
+        explicit shared_memory(int fd) : _fd(fd), _data(JM_CB_NULLPTR), _size(0)
+        {
+            struct stat info;
+            if(::fstat(_fd, &info) != 0) {
+                const int error = errno;
+                close();
+                throw std::system_error(error, std::generic_category(), "fstat");
+            }
+
+            _size = static_cast<std::size_t>(info.st_size);
+            map();
+        }
+
+        shared_memory(const shared_memory&) = delete;
+        shared_memory& operator=(const shared_memory&) = delete;
+
+        ~shared_memory() { close(); }
+
+        /// removes the name, the memory stays valid while it is mapped
+        static void unlink(const char* name) noexcept { ::shm_unlink(name); }
+
+        void*       data() const noexcept { return _data; }
+        std::size_t size() const noexcept { return _size; }
+        int         native_handle() const noexcept { return _fd; }
+    };
+
+    /// lock free ring for one producer and one consumer process, placed in memory that
+    /// both of them map, for example a jm::shared_memory. It is a handle that only
+    /// keeps the address of the mapping in this process, the positions and elements are
+    /// stored in the memory so a handle can be created in each process independently.
+    /// Elements are copied with memcpy so T has to be trivially copyable and must not
+    /// contain pointers into either process.
+    /// Wait is used by the blocking push and pop, futex_wait makes them sleep.
+    template<typename T, class Wait = spin_wait>
+    class shared_spsc_circular_buffer {
+    public:
+        typedef T              value_type;
+        typedef std::size_t    size_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T&             reference;
+        typedef const T&       const_reference;
+        typedef T*             pointer;
+        typedef const T*       const_pointer;
+
+        static_assert(JM_CB_IS_TRIVIALLY_COPYABLE(T),
+                      "shared_spsc_circular_buffer requires trivially copyable elements");
+
+    private:
+        typedef detail::cb_dynamic_index_wrapper<std::uint32_t> position_t;
+        typedef detail::cb_copier<T>                            copier_t;
+
+        static const std::size_t alignment =
+            (alignof(T) > JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) ? alignof(T)
+                                                               : JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE;
+
+        static const std::size_t slots_offset =
+            (sizeof(detail::cb_shared_header) + alignment - 1) / alignment * alignment;
+
+        detail::cb_shared_header* _header;
+        pointer                   _buffer;
+        std::uint32_t             _capacity;
+        // positions run over [0, 2 * capacity) like in spsc_circular_buffer
+        position_t    _position;
+        std::uint32_t _cached_head; // producer
+        std::uint32_t _cached_tail; // consumer
+
+        explicit shared_spsc_circular_buffer(void* memory) noexcept
+            : _header(static_cast<detail::cb_shared_header*>(memory))
+            , _buffer(reinterpret_cast<pointer>(static_cast<char*>(memory) + slots_offset))
+            , _capacity(_header->capacity)
+            , _position(2 * _capacity)
+            , _cached_head(_header->head.load(std::memory_order_relaxed))
+            , _cached_tail(_header->tail.load(std::memory_order_relaxed))
+        {}
+
+        size_type index(std::uint32_t pos) const noexcept
+        {
+            return (pos < _capacity) ? pos : pos - _capacity;
+        }
+
+        size_type distance(std::uint32_t from, std::uint32_t to) const noexcept
+        {
+            return (to >= from) ? to - from : to + 2 * _capacity - from;
+        }
+
+        size_type contiguous(size_type idx, size_type count) const noexcept
+        {
+            return (count < _capacity - idx) ? count : _capacity - idx;
+        }
+
+        size_type writable(std::uint32_t tail, size_type count) noexcept
+        {
+            size_type available = _capacity - distance(_cached_head, tail);
+            if(available < count) {
+                _cached_head = _header->head.load(std::memory_order_acquire);
+                available    = _capacity - distance(_cached_head, tail);
+            }
+
+            return (count < available) ? count : available;
+        }
+
+        size_type readable(std::uint32_t head, size_type count) noexcept
+        {
+            size_type available = distance(head, _cached_tail);
+            if(available < count) {
+                _cached_tail = _header->tail.load(std::memory_order_acquire);
+                available    = distance(head, _cached_tail);
+            }
+
+            return (count < available) ? count : available;
+        }
+
+        // publishes the new position and wakes the other side if it went to sleep.
+        // the fence orders the store before the load of the flag, which pairs with the
+        // sleeping side setting the flag before checking the position one last time.
+        static void publish(detail::cb_shared_position& position,
+                            std::uint32_t               value,
+                            detail::cb_shared_position& waiting) noexcept
+        {
+            position.store(value, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(JM_CB_UNLIKELY(waiting.load(std::memory_order_relaxed) != 0))
+                Wait::notify(position);
+        }
+
+        // sleeps until position is no longer old
+        static void sleep(detail::cb_shared_position& position,
+                          std::uint32_t               old,
+                          detail::cb_shared_position& waiting) noexcept
+        {
+            waiting.store(1, std::memory_order_seq_cst);
+            if(position.load(std::memory_order_seq_cst) == old)
+                Wait::wait(position, old);
+            waiting.store(0, std::memory_order_relaxed);
+        }
+
+    public:
+        /// largest capacity. Advancing a position in [0, 2 * capacity) by up to
+        /// capacity has to fit into the 32 bit positions.
+        static constexpr size_type max_capacity = UINT32_MAX / 3;
+
+        /// bytes of shared memory needed for capacity elements
+        static constexpr size_type required_size(size_type capacity) noexcept
+        {
+            return slots_offset + capacity * sizeof(T);
+        }
+
+        /// initializes an empty ring in memory, which must be at least
+        /// required_size(capacity) bytes, aligned to a cache line and not in use by
+        /// another process yet. Throws std::invalid_argument unless capacity is in
+        /// [1, max_capacity].
+        static shared_spsc_circular_buffer create(void* memory, size_type capacity)
+        {
+            if(capacity == 0 || capacity > max_capacity)
+                throw std::invalid_argument("shared_spsc_circular_buffer: invalid capacity");
+
+            detail::cb_shared_header* header = static_cast<detail::cb_shared_header*>(memory);
+            new(header) detail::cb_shared_header();
+            header->version      = detail::cb_shared_version;
+            header->element_size = sizeof(T);
+            header->capacity     = static_cast<std::uint32_t>(capacity);
+            header->reserved     = 0;
+            header->tail.store(0, std::memory_order_relaxed);
+            header->producer_waiting.store(0, std::memory_order_relaxed);
+            header->head.store(0, std::memory_order_relaxed);
+            header->consumer_waiting.store(0, std::memory_order_relaxed);
+
+            // the magic marks the header as complete for attach
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(header->magic, detail::cb_shared_magic, sizeof(header->magic));
+            return shared_spsc_circular_buffer(memory);
+        }
+
+        /// uses the ring that create initialized in memory of size bytes, possibly in
+        /// another process. Throws std::runtime_error if there is none or it was created
+        /// for a different element type or version.
+        static shared_spsc_circular_buffer attach(void* memory, size_type size)
+        {
+            const detail::cb_shared_header* header =
+                static_cast<const detail::cb_shared_header*>(memory);
+            if(size < sizeof(detail::cb_shared_header) ||
+               std::memcmp(header->magic, detail::cb_shared_magic, sizeof(header->magic)) != 0)
+                throw std::runtime_error("shared_spsc_circular_buffer: no ring in memory");
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if(header->version != detail::cb_shared_version)
+                throw std::runtime_error("shared_spsc_circular_buffer: unsupported version");
+            if(header->element_size != sizeof(T))
+                throw std::runtime_error("shared_spsc_circular_buffer: element type mismatch");
+            if(header->capacity == 0 || header->capacity > max_capacity)
+                throw std::runtime_error("shared_spsc_circular_buffer: corrupted capacity");
+            if(size < required_size(header->capacity))
+                throw std::runtime_error("shared_spsc_circular_buffer: memory too small");
+
+            return shared_spsc_circular_buffer(memory);
+        }
+
+        /// capacity
+        bool empty() const noexcept { return size() == 0; }
+
+        bool full() const noexcept { return size() == _capacity; }
+
+        size_type size() const noexcept
+        {
+            const std::uint32_t head = _header->head.load(std::memory_order_acquire);
+            return distance(head, _header->tail.load(std::memory_order_acquire));
+        }
+
+        size_type max_size() const noexcept { return _capacity; }
+
+        /// producer
+        bool try_push(const value_type& value) noexcept { return try_push(&value, 1) == 1; }
+
+        /// pushes up to count elements from src and publishes them at once.
+        /// returns the number of elements that were pushed.
+        size_type try_push(const_pointer src, size_type count) noexcept
+        {
+            const std::uint32_t tail = _header->tail.load(std::memory_order_relaxed);
+            count                    = writable(tail, count);
+            if(count == 0)
+                return 0;
+
+            const size_type first_count = contiguous(index(tail), count);
+            copier_t::copy_n(src, first_count, _buffer + index(tail));
+            copier_t::copy_n(src + first_count, count - first_count, _buffer);
+
+            publish(_header->tail,
+                    _position.advance(tail, static_cast<difference_type>(count)),
+                    _header->consumer_waiting);
+            return count;
+        }
+
+        /// waits using Wait until there is space for value
+        void push(const value_type& value) noexcept
+        {
+            while(!try_push(value))
+                sleep(_header->head, _cached_head, _header->producer_waiting);
+        }
+
+        /// consumer
+        bool try_pop(reference out) noexcept { return try_pop(&out, 1) == 1; }
+
+        /// pops up to count elements into dest and releases their slots at once.
+        /// returns the number of elements that were popped.
+        size_type try_pop(pointer dest, size_type count) noexcept
+        {
+            const std::uint32_t head = _header->head.load(std::memory_order_relaxed);
+            count                    = readable(head, count);
+            if(count == 0)
+                return 0;
+
+            const size_type first_count = contiguous(index(head), count);
+            copier_t::copy_n(_buffer + index(head), first_count, dest);
+            copier_t::copy_n(_buffer, count - first_count, dest + first_count);
+
+            publish(_header->head,
+                    _position.advance(head, static_cast<difference_type>(count)),
+                    _header->producer_waiting);
+            return count;
+        }
+
+        /// waits using Wait until there is an element to pop
+        void pop(reference out) noexcept
+        {
+            while(!try_pop(out))
+                sleep(_header->tail, _cached_tail, _header->consumer_waiting);
+        }
+    };
+
+} // namespace jm
+
+#endif // JM_SHARED_CIRCULAR_BUFFER_HPP
@@ -0,0 +1,302 @@
+/*
+ * Copyright 2017 Justas Masiulis
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JM_SOA_CIRCULAR_BUFFER_HPP
+#define JM_SOA_CIRCULAR_BUFFER_HPP
+
+#include "circular_buffer.hpp"
+#include <tuple>
+
+#if defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+#error "soa_circular_buffer requires c++11"
+#endif
+
+namespace jm {
+
+    namespace detail {
+
+        // the slots of one field, on their own cache lines
+        template<class F, std::size_t N>
+        struct alignas(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE) cb_soa_lane {
+            optional_storage<F> slots[N];
+
+            cb_soa_lane() : slots() {}
+        };
+
+        template<bool... Values>
+        struct cb_bool_pack {
+        };
+
+        template<bool... Values>
+        struct cb_all_of
+            : std::is_same<cb_bool_pack<true, Values...>, cb_bool_pack<Values..., true>> {
+        };
+
+    } // namespace detail
+
+    /// circular buffer of records whose fields are stored in separate arrays that
+    /// share one head, tail and size, so a loop over one field only loads that
+    /// field. Every lane is split into at most two contiguous segments, the same
+    /// way for all lanes. Fields have to be trivially copyable, they are assigned
+    /// into the slots and never destroyed.
+    template<std::size_t N, class... Fields>
+    class soa_circular_buffer
+        : private detail::cb_indices<
+              typename detail::cb_index_type<N>::type,
+              detail::cb_is_monotonic<
+                  typename detail::cb_select_index_wrapper<std::size_t, N>::type>::value> {
+        static_assert(N > 0, "the capacity has to be at least 1");
+        static_assert(sizeof...(Fields) > 0, "there has to be at least one field");
+        static_assert(detail::cb_all_of<JM_CB_IS_TRIVIALLY_COPYABLE(Fields)...>::value,
+                      "fields have to be trivially copyable");
+
+        typedef typename detail::cb_select_index_wrapper<std::size_t, N>::type wrapper_type;
+        typedef detail::cb_index_wrapper<std::size_t, N> iterator_wrapper_type;
+        typedef detail::cb_indices<typename detail::cb_index_type<N>::type,
+                                   detail::cb_is_monotonic<wrapper_type>::value>
+            indices_type;
+
+        using indices_type::_head;
+        using indices_type::_tail;
+
+        std::tuple<detail::cb_soa_lane<Fields, N>...> _lanes;
+
+        static wrapper_type wrapper() noexcept { return wrapper_type(); }
+
+        std::size_t begin_index() const noexcept { return wrapper().index(_head); }
+
+        std::size_t end_index() const noexcept
+        {
+            return wrapper().index(wrapper().increment(_tail));
+        }
+
+        std::size_t slot_index(std::size_t pos) const noexcept
+        {
+            return wrapper().index(wrapper().advance(_head, static_cast<std::ptrdiff_t>(pos)));
+        }
+
+        std::size_t contiguous(std::size_t idx, std::size_t count) const noexcept
+        {
+            return (count < N - idx) ? count : N - idx;
+        }
+
+        template<std::size_t I>
+        void store(std::size_t) noexcept
+        {}
+
+        template<std::size_t I, class F, class... Rest>
+        void store(std::size_t idx, const F& value, const Rest&... rest) noexcept
+        {
+            std::get<I>(_lanes).slots[idx]._value = value;
+            store<I + 1>(idx, rest...);
+        }
+
+    public:
+        typedef std::size_t    size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        template<std::size_t I>
+        using field_type = typename std::tuple_element<I, std::tuple<Fields...>>::type;
+
+        template<std::size_t I>
+        using iterator = detail::cb_iterator<detail::optional_storage<field_type<I>>,
+                                             field_type<I>,
+                                             iterator_wrapper_type>;
+
+        template<std::size_t I>
+        using const_iterator = detail::cb_iterator<const detail::optional_storage<field_type<I>>,
+                                                   const field_type<I>,
+                                                   iterator_wrapper_type>;
+
+        template<std::size_t I>
+        using array_range = std::pair<field_type<I>*, size_type>;
+
+        template<std::size_t I>
+        using const_array_range = std::pair<const field_type<I>*, size_type>;
+
+        soa_circular_buffer() : indices_type(wrapper().increment(0)), _lanes() {}
+
+        /// capacity
+        bool      empty() const noexcept { return size() == 0; }
+        bool      full() const noexcept { return size() == N; }
+        size_type size() const noexcept { return this->stored_size(); }
+        constexpr size_type capacity() const noexcept { return N; }
+
+        /// element access, the field I of the record at pos
+        template<std::size_t I>
+        field_type<I>& get(size_type pos) noexcept
+        {
+            return std::get<I>(_lanes).slots[slot_index(pos)]._value;
+        }
+
+        template<std::size_t I>
+        const field_type<I>& get(size_type pos) const noexcept
+        {
+            return std::get<I>(_lanes).slots[slot_index(pos)]._value;
+        }
+
+        template<std::size_t I>
+        field_type<I>& front() noexcept
+        {
+            return std::get<I>(_lanes).slots[begin_index()]._value;
+        }
+
+        template<std::size_t I>
+        const field_type<I>& front() const noexcept
+        {
+            return std::get<I>(_lanes).slots[begin_index()]._value;
+        }
+
+        template<std::size_t I>
+        field_type<I>& back() noexcept
+        {
+            return std::get<I>(_lanes).slots[wrapper().index(_tail)]._value;
+        }
+
+        template<std::size_t I>
+        const field_type<I>& back() const noexcept
+        {
+            return std::get<I>(_lanes).slots[wrapper().index(_tail)]._value;
+        }
+
+        /// the records of field I are array_one<I>() followed by array_two<I>()
+        template<std::size_t I>
+        array_range<I> array_one() noexcept
+        {
+            return array_range<I>(JM_CB_ADDRESSOF(std::get<I>(_lanes).slots[begin_index()]._value),
+                                  contiguous(begin_index(), size()));
+        }
+
+        template<std::size_t I>
+        const_array_range<I> array_one() const noexcept
+        {
+            return const_array_range<I>(
+                JM_CB_ADDRESSOF(std::get<I>(_lanes).slots[begin_index()]._value),
+                contiguous(begin_index(), size()));
+        }
+
+        template<std::size_t I>
+        array_range<I> array_two() noexcept
+        {
+            return array_range<I>(JM_CB_ADDRESSOF(std::get<I>(_lanes).slots[0]._value),
+                                  size() - contiguous(begin_index(), size()));
+        }
+
+        template<std::size_t I>
+        const_array_range<I> array_two() const noexcept
+        {
+            return const_array_range<I>(JM_CB_ADDRESSOF(std::get<I>(_lanes).slots[0]._value),
+                                        size() - contiguous(begin_index(), size()));
+        }
+
+        /// calls f(first, last) with the pointer ranges of field I that are not empty,
+        /// in logical order. returns f like std::for_each.
+        template<std::size_t I, class F>
+        F for_each_segment(F f) const
+        {
+            const const_array_range<I> one = array_one<I>();
+            const const_array_range<I> two = array_two<I>();
+            if(one.second != 0)
+                f(one.first, one.first + one.second);
+            if(two.second != 0)
+                f(two.first, two.first + two.second);
+
+            return f;
+        }
+
+        /// iterators over field I
+        template<std::size_t I>
+        iterator<I> begin() noexcept
+        {
+            if(empty())
+                return end<I>();
+            return iterator<I>(std::get<I>(_lanes).slots, begin_index(), size());
+        }
+
+        template<std::size_t I>
+        const_iterator<I> begin() const noexcept
+        {
+            if(empty())
+                return end<I>();
+            return const_iterator<I>(std::get<I>(_lanes).slots, begin_index(), size());
+        }
+
+        template<std::size_t I>
+        iterator<I> end() noexcept
+        {
+            return iterator<I>(std::get<I>(_lanes).slots, end_index(), 0);
+        }
+
+        template<std::size_t I>
+        const_iterator<I> end() const noexcept
+        {
+            return const_iterator<I>(std::get<I>(_lanes).slots, end_index(), 0);
+        }
+
+        /// modifiers
+        /// appends a record, overwriting the front if full
+        void push_back(const Fields&... values) noexcept
+        {
+            const std::size_t new_tail = wrapper().increment(_tail);
+            if(JM_CIRCULAR_BUFFER_FULLNESS_LIKEHOOD(full())) {
+                _head = wrapper().increment(_head);
+                this->shrink_size(1);
+            }
+
+            store<0>(wrapper().index(new_tail), values...);
+            _tail = new_tail;
+            this->grow_size(1);
+        }
+
+        /// appends a record unless full, returns whether it was appended
+        bool try_push_back(const Fields&... values) noexcept
+        {
+            if(full())
+                return false;
+
+            push_back(values...);
+            return true;
+        }
+
+        void pop_front() noexcept { pop_front(1); }
+
+        /// removes count records from the front, count must not exceed size()
+        void pop_front(size_type count) noexcept
+        {
+            _head = wrapper().advance(_head, static_cast<difference_type>(count));
+            this->shrink_size(count);
+        }
+
+        void pop_back() noexcept { pop_back(1); }
+
+        /// removes count records from the back, count must not exceed size()
+        void pop_back(size_type count) noexcept
+        {
+            _tail = wrapper().advance(_tail, -static_cast<difference_type>(count));
+            this->shrink_size(count);
+        }
+
+        void clear() noexcept
+        {
+            _head = wrapper().increment(0);
+            _tail = 0;
+            this->reset_size();
+        }
+    };
+
+} // namespace jm
+
+#endif // JM_SOA_CIRCULAR_BUFFER_HPP
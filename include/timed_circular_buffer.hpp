@@ -0,0 +1,180 @@
+/*
+ * Copyright 2017 Justas Masiulis
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JM_TIMED_CIRCULAR_BUFFER_HPP
+#define JM_TIMED_CIRCULAR_BUFFER_HPP
+
+#include "circular_buffer.hpp"
+#include <chrono>
+
+#if defined(JM_CIRCULAR_BUFFER_CXX_OLD)
+#error "timed_circular_buffer requires c++11"
+#endif
+
+namespace jm {
+
+    /// the values of a time range, one followed by two like array_one() and array_two()
+    template<class T>
+    struct timed_range {
+        std::pair<T*, std::size_t> one;
+        std::pair<T*, std::size_t> two;
+
+        std::size_t size() const noexcept { return one.second + two.second; }
+        bool        empty() const noexcept { return size() == 0; }
+    };
+
+    /// circular_buffer of values that each carry a timestamp, for keeping the last
+    /// period of events instead of the last N. The timestamps are kept in a buffer of
+    /// their own next to the values, so searching them does not touch the values.
+    /// Timestamps have to be pushed in non decreasing order and copying one must not
+    /// throw.
+    template<class T, std::size_t N, class Timestamp = std::chrono::steady_clock::time_point>
+    class timed_circular_buffer {
+        typedef circular_buffer<T, N>         value_buffer;
+        typedef circular_buffer<Timestamp, N> timestamp_buffer;
+
+        // both buffers see the same operations, so an element and its timestamp
+        // always occupy the same slot
+        value_buffer     _values;
+        timestamp_buffer _timestamps;
+
+        typename value_buffer::iterator at(std::size_t pos) noexcept
+        {
+            return _values.begin() + static_cast<std::ptrdiff_t>(pos);
+        }
+
+        typename value_buffer::const_iterator at(std::size_t pos) const noexcept
+        {
+            return _values.begin() + static_cast<std::ptrdiff_t>(pos);
+        }
+
+    public:
+        typedef Timestamp                              timestamp_type;
+        typedef typename value_buffer::value_type      value_type;
+        typedef typename value_buffer::size_type       size_type;
+        typedef typename value_buffer::reference       reference;
+        typedef typename value_buffer::const_reference const_reference;
+        typedef typename value_buffer::iterator        iterator;
+        typedef typename value_buffer::const_iterator  const_iterator;
+
+        /// the underlying buffers for read only access, e.g. to jm::cb algorithms
+        const value_buffer&     values() const noexcept { return _values; }
+        const timestamp_buffer& timestamps() const noexcept { return _timestamps; }
+
+        bool      empty() const noexcept { return _values.empty(); }
+        bool      full() const noexcept { return _values.full(); }
+        size_type size() const noexcept { return _values.size(); }
+        constexpr size_type capacity() const noexcept { return N; }
+
+        reference       front() noexcept { return _values.front(); }
+        const_reference front() const noexcept { return _values.front(); }
+        reference       back() noexcept { return _values.back(); }
+        const_reference back() const noexcept { return _values.back(); }
+        reference       operator[](size_type pos) noexcept { return _values[pos]; }
+        const_reference operator[](size_type pos) const noexcept { return _values[pos]; }
+
+        const Timestamp& front_timestamp() const noexcept { return _timestamps.front(); }
+        const Timestamp& back_timestamp() const noexcept { return _timestamps.back(); }
+        const Timestamp& timestamp(size_type pos) const noexcept { return _timestamps[pos]; }
+
+        iterator       begin() noexcept { return _values.begin(); }
+        const_iterator begin() const noexcept { return _values.begin(); }
+        iterator       end() noexcept { return _values.end(); }
+        const_iterator end() const noexcept { return _values.end(); }
+
+        /// appends value stamped with time, overwriting the front if full.
+        /// time must not be before back_timestamp().
+        void push_back(const Timestamp& time, const T& value)
+        {
+            _values.push_back(value);
+            _timestamps.push_back(time);
+        }
+
+        void push_back(const Timestamp& time, T&& value)
+        {
+            _values.push_back(std::move(value));
+            _timestamps.push_back(time);
+        }
+
+        template<class... Args>
+        void emplace_back(const Timestamp& time, Args&&... args)
+        {
+            _values.emplace_back(std::forward<Args>(args)...);
+            _timestamps.push_back(time);
+        }
+
+        void pop_front() noexcept
+        {
+            _values.pop_front();
+            _timestamps.pop_front();
+        }
+
+        void pop_front(size_type count) noexcept
+        {
+            _values.pop_front(count);
+            _timestamps.pop_front(count);
+        }
+
+        void clear() noexcept
+        {
+            _values.clear();
+            _timestamps.clear();
+        }
+
+        /// position of the first element whose timestamp is not before time, found by
+        /// binary search. size() if there is none.
+        size_type lower_bound(const Timestamp& time) const
+        {
+            return static_cast<size_type>(
+                std::lower_bound(_timestamps.begin(), _timestamps.end(), time) -
+                _timestamps.begin());
+        }
+
+        /// removes every element stamped before time at once, returns how many
+        size_type expire_before(const Timestamp& time)
+        {
+            const size_type count = lower_bound(time);
+            pop_front(count);
+            return count;
+        }
+
+        /// the values stamped within [first, last)
+        timed_range<T> range(const Timestamp& first, const Timestamp& last)
+        {
+            const size_type              from = lower_bound(first);
+            const size_type              to   = (last < first) ? from : lower_bound(last);
+            const detail::cb_segments<T> s    = at(from).segments(at(to));
+
+            const timed_range<T> result = {std::make_pair(s.one, s.one_count),
+                                           std::make_pair(s.two, s.two_count)};
+            return result;
+        }
+
+        timed_range<const T> range(const Timestamp& first, const Timestamp& last) const
+        {
+            const size_type                    from = lower_bound(first);
+            const size_type                    to = (last < first) ? from : lower_bound(last);
+            const detail::cb_segments<const T> s  = at(from).segments(at(to));
+
+            const timed_range<const T> result = {std::make_pair(s.one, s.one_count),
+                                                 std::make_pair(s.two, s.two_count)};
+            return result;
+        }
+    };
+
+} // namespace jm
+
+#endif // JM_TIMED_CIRCULAR_BUFFER_HPP
@@ -1,11 +1,73 @@
 #define CATCH_CONFIG_MAIN
 #define JM_CIRCULAR_BUFFER_CXX14
 #include <circular_buffer.hpp>
+#include <circular_buffer_algorithm.hpp>
+#include <rolling_circular_buffer.hpp>
+#include <timed_circular_buffer.hpp>
+#include <soa_circular_buffer.hpp>
+#include <serialized_circular_buffer.hpp>
+#if defined(__cpp_impl_coroutine)
+#include <async_circular_buffer.hpp>
+#define JM_CB_TEST_COROUTINES
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <mapped_circular_buffer.hpp>
+#include <shared_circular_buffer.hpp>
+#include <mirrored_circular_buffer.hpp>
+#include <sys/wait.h>
+#define JM_CB_TEST_POSIX
+#endif
 #include "../Catch/include/catch.hpp"
 
 #include <numeric>
+#include <list>
+#include <sstream>
+#include <iterator>
+#include <cstring>
+#include <cstddef>
+#include <functional>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
 #include <vector>
 #include <atomic>
+#include <thread>
+#include <memory>
+
+// new only honors the alignment of over aligned types such as the cache line
+// aligned rings from c++17 on, so big ones are placed into over allocated memory
+template<class T>
+struct aligned_deleter {
+    void* memory;
+
+    void operator()(T* p) const
+    {
+        p->~T();
+        std::free(memory);
+    }
+};
+
+template<class T>
+using aligned_ptr = std::unique_ptr<T, aligned_deleter<T>>;
+
+template<class T>
+aligned_ptr<T> make_aligned()
+{
+    std::size_t space  = sizeof(T) + alignof(T);
+    void*       memory = std::malloc(space);
+    void*       p      = memory;
+    if(memory == nullptr || std::align(alignof(T), sizeof(T), p, space) == nullptr)
+        throw std::bad_alloc();
+
+    try {
+        return aligned_ptr<T>(::new(p) T(), aligned_deleter<T>{memory});
+    }
+    catch(...) {
+        std::free(memory);
+        throw;
+    }
+}
 
 std::uint64_t num_constructions = 0;
 std::uint64_t num_deletions     = 0;
@@ -139,6 +201,59 @@ TEST_CASE("move assignment")
     REQUIRE(std::equal(cb.begin(), cb.end(), other.begin()));
 }
 
+TEST_CASE("copy and assignment of wrapped buffers")
+{
+    SECTION("trivial")
+    {
+        jm::circular_buffer<int, 5> cb;
+        cb.append(inc_vec.data(), 7); // 23456
+
+        decltype(cb) copy = cb;
+        REQUIRE(std::equal(cb.begin(), cb.end(), copy.begin()));
+        REQUIRE(copy.array_one().second == cb.array_one().second);
+
+        decltype(cb) other;
+        other.push_back(1);
+        other = cb;
+        REQUIRE(std::equal(cb.begin(), cb.end(), other.begin()));
+        other = other;
+        REQUIRE(other.size() == 5);
+
+        decltype(cb) moved = std::move(copy);
+        REQUIRE(std::equal(cb.begin(), cb.end(), moved.begin()));
+    }
+
+    SECTION("non trivial")
+    {
+        const auto constructions = num_constructions;
+        const auto deletions     = num_deletions;
+        {
+            jm::circular_buffer<leak_checker, 4> cb;
+            for(int i = 0; i < 6; ++i)
+                cb.emplace_back();
+
+            jm::circular_buffer<leak_checker, 4> copy = cb;
+            REQUIRE(copy.size() == 4);
+            REQUIRE(num_constructions - constructions == 10);
+
+            // the existing elements are assigned to instead of being rebuilt
+            jm::circular_buffer<leak_checker, 4> other;
+            other.emplace_back();
+            other.emplace_back();
+            const auto before = num_constructions;
+            other             = cb;
+            REQUIRE(other.size() == 4);
+            REQUIRE(num_constructions - before == 2);
+
+            cb.pop_back(3);
+            other = std::move(cb);
+            REQUIRE(other.size() == 1);
+            REQUIRE(num_constructions - before == 2);
+        }
+        REQUIRE(num_constructions - constructions == num_deletions - deletions);
+    }
+}
+
 #ifndef JM_CIRCULAR_BUFFER_CXX_OLD
 TEST_CASE("initializer_list construction")
 {
@@ -283,6 +398,78 @@ TEST_CASE("push_front")
     REQUIRE(cb.size() == cb.max_size());
 }
 
+TEST_CASE("index wrapping")
+{
+    SECTION("power of two")
+    {
+        using wrapper = jm::detail::cb_index_wrapper<std::size_t, 8>;
+        REQUIRE(wrapper::increment(6) == 7);
+        REQUIRE(wrapper::increment(7) == 0);
+        REQUIRE(wrapper::decrement(0) == 7);
+        REQUIRE(wrapper::decrement(3) == 2);
+    }
+
+    SECTION("non power of two")
+    {
+        using wrapper = jm::detail::cb_index_wrapper<std::size_t, 5>;
+        REQUIRE(wrapper::increment(3) == 4);
+        REQUIRE(wrapper::increment(4) == 0);
+        REQUIRE(wrapper::decrement(0) == 4);
+        REQUIRE(wrapper::decrement(3) == 2);
+    }
+
+    SECTION("monotonic")
+    {
+        using wrapper = jm::detail::cb_monotonic_index_wrapper<std::size_t, 8>;
+        REQUIRE(wrapper::increment(7) == 8);
+        REQUIRE(wrapper::index(8) == 0);
+        REQUIRE(wrapper::index(wrapper::decrement(0)) == 7);
+    }
+
+    SECTION("non power of two buffer")
+    {
+        jm::circular_buffer<int, 5> cb;
+        for(auto i : inc_vec) {
+            cb.push_back(i);
+            REQUIRE(cb.back() == i);
+            auto front = cb.front();
+            for(auto v : cb)
+                REQUIRE(v == front++);
+        }
+
+        for(int i = 0; i < 3; ++i)
+            cb.pop_front();
+        REQUIRE(cb.size() == 2);
+        REQUIRE(cb.front() == inc_vec.back() - 1);
+    }
+
+    SECTION("compact indices")
+    {
+        static_assert(sizeof(jm::detail::cb_index_type<255>::type) == 1, "");
+        static_assert(sizeof(jm::detail::cb_index_type<256>::type) == 2, "");
+#if !defined(JM_CIRCULAR_BUFFER_STATISTICS)
+        REQUIRE(sizeof(jm::circular_buffer<char, 16>) <= 16 + 3);
+#endif
+
+        // indices wrap around their narrow type many times over
+        jm::circular_buffer<int, 128> cb;
+        for(int i = 0; i < 2000; ++i) {
+            cb.push_back(i);
+            if(i % 3 == 0)
+                cb.pop_front();
+            if(i % 5 == 0)
+                cb.push_front(-i);
+        }
+
+        REQUIRE(cb.size() == 128);
+        REQUIRE(cb.back() == 1999);
+        REQUIRE(cb.end() - cb.begin() == 128);
+
+        cb.pop_front(128);
+        REQUIRE(cb.empty());
+    }
+}
+
 #ifndef JM_CIRCULAR_BUFFER_CXX_OLD
 TEST_CASE("emplace_back")
 {
@@ -316,6 +503,117 @@ TEST_CASE("emplace_front")
 }
 #endif
 
+TEST_CASE("statistics")
+{
+#if defined(JM_CIRCULAR_BUFFER_STATISTICS)
+    jm::circular_buffer<int, 4> cb;
+    REQUIRE(cb.statistics().pushes == 0);
+
+    for(int i = 0; i < 6; ++i)
+        cb.push_back(i);
+    REQUIRE_FALSE(cb.try_push_back(6));
+    cb.pop_front();
+    cb.emplace_back(7);
+    cb.emplace_front(8);
+
+    const int src[] = {1, 2, 3};
+    cb.append(src, 3);
+    cb.clear();
+
+    const jm::circular_buffer_statistics stats = cb.statistics();
+    REQUIRE(stats.pushes == 11);
+    REQUIRE(stats.overwrites == 6);
+    REQUIRE(stats.rejected == 1);
+    REQUIRE(stats.pops == 5);
+    REQUIRE(stats.peak_size == 4);
+
+    // appending more than fits counts the same as pushing one at a time
+    const int many[] = {1, 2, 3, 4, 5, 6, 7};
+    jm::circular_buffer<int, 4> appended;
+    jm::circular_buffer<int, 4> pushed;
+    appended.push_back(0);
+    pushed.push_back(0);
+    appended.append(many, 7);
+    for(int value : many)
+        pushed.push_back(value);
+    REQUIRE(appended.statistics().pushes == pushed.statistics().pushes);
+    REQUIRE(appended.statistics().overwrites == pushed.statistics().overwrites);
+    REQUIRE(appended.statistics().overwrites == 4);
+
+    cb.push_back(1);
+    cb.reset_statistics();
+    REQUIRE(cb.statistics().pushes == 0);
+    REQUIRE(cb.statistics().peak_size == 1);
+
+    // copies count their own operations
+    jm::circular_buffer<int, 4> copy = cb;
+    REQUIRE(copy.statistics().pushes == 0);
+
+    // reallocating moves the elements without popping them
+    jm::dynamic_circular_buffer<std::string> strings(2);
+    strings.push_back("a");
+    strings.push_back("b");
+    strings.reserve(10);
+    strings.shrink_to_fit();
+    REQUIRE(strings.statistics().pushes == 2);
+    REQUIRE(strings.statistics().pops == 0);
+    strings.set_capacity(1);
+    REQUIRE(strings.size() == 1);
+    REQUIRE(strings.statistics().pops == 1);
+
+    jm::dynamic_circular_buffer<int> ints(3);
+    for(int i = 0; i < 3; ++i)
+        ints.push_back(i);
+    ints.reserve(10);
+    REQUIRE(ints.statistics().pushes == 3);
+    REQUIRE(ints.statistics().pops == 0);
+    ints.set_capacity(2);
+    REQUIRE(ints.statistics().pops == 1);
+#else
+    // nothing is stored when they are disabled
+    static_assert(std::is_empty<jm::detail::cb_statistics_recorder>::value, "");
+    REQUIRE(sizeof(jm::circular_buffer<char, 16>) <= 16 + 3);
+#endif
+}
+
+TEST_CASE("try push and overwrite")
+{
+    SECTION("try_push rejects when full")
+    {
+        jm::circular_buffer<int, 3> cb;
+        REQUIRE(cb.try_push_back(1));
+        REQUIRE(cb.try_push_front(0));
+        REQUIRE(cb.try_emplace_back(2));
+        REQUIRE_FALSE(cb.try_push_back(3));
+        REQUIRE_FALSE(cb.try_push_front(-1));
+        REQUIRE_FALSE(cb.try_emplace_front(-1));
+        REQUIRE(cb.front() == 0);
+        REQUIRE(cb.back() == 2);
+
+        cb.pop_front();
+        REQUIRE(cb.try_emplace_front(-1));
+        REQUIRE(cb.front() == -1);
+    }
+
+    SECTION("overwrite hands out the evicted element")
+    {
+        jm::circular_buffer<std::vector<int>, 2> cb;
+        std::vector<int>                         evicted;
+        REQUIRE_FALSE(cb.push_back_overwrite(std::vector<int>{1}, evicted));
+        REQUIRE_FALSE(cb.push_back_overwrite(std::vector<int>{2}, evicted));
+        REQUIRE(cb.push_back_overwrite(std::vector<int>{3}, evicted));
+        REQUIRE(evicted == std::vector<int>{1});
+        REQUIRE(cb.front() == std::vector<int>{2});
+
+        const std::vector<int> zero{0};
+        REQUIRE(cb.push_front_overwrite(zero, evicted));
+        REQUIRE(evicted == std::vector<int>{3});
+        REQUIRE(cb.front() == zero);
+        REQUIRE(cb.back() == std::vector<int>{2});
+        REQUIRE(cb.size() == 2);
+    }
+}
+
 TEST_CASE("cb_iterator complies to Iterator")
 {
     using cbt = jm::circular_buffer<int, 4>;
@@ -426,3 +724,1829 @@ TEST_CASE("cb_iterator complies to InputIterator")
     cbt::const_iterator non_c_it = it;
     non_c_it                     = it;
 }
+
+TEST_CASE("cb_iterator complies to RandomAccessIterator")
+{
+    using cbt = jm::circular_buffer<int, 5>;
+    static_assert(std::is_same<std::iterator_traits<cbt::iterator>::iterator_category,
+                               std::random_access_iterator_tag>::value,
+                  "iterator is not random access");
+
+    cbt cb;
+    for(int i = 0; i < 8; ++i)
+        cb.push_back(i); // 34567, wrapped around
+
+    auto first = cb.begin();
+    auto last  = cb.end();
+
+    REQUIRE(last - first == 5);
+    REQUIRE(std::distance(first, last) == 5);
+    REQUIRE(first + 5 == last);
+    REQUIRE(5 + first == last);
+    REQUIRE(last - 5 == first);
+    REQUIRE(first < last);
+    REQUIRE(last > first);
+    REQUIRE(first <= first);
+    REQUIRE(first >= first);
+
+    for(int i = 0; i < 5; ++i) {
+        REQUIRE(first[i] == i + 3);
+        REQUIRE(*(first + i) == i + 3);
+        REQUIRE(*(last - (5 - i)) == i + 3);
+    }
+
+    auto it = first;
+    it += 4;
+    REQUIRE(*it == 7);
+    it -= 3;
+    REQUIRE(*it == 4);
+
+    cbt::const_iterator cit = it;
+    REQUIRE(cit - first == 1);
+
+    REQUIRE(*std::lower_bound(cb.begin(), cb.end(), 5) == 5);
+
+    std::sort(cb.begin(), cb.end(), std::greater<int>());
+    REQUIRE(std::is_sorted(cb.begin(), cb.end(), std::greater<int>()));
+    REQUIRE(cb.front() == 7);
+    REQUIRE(cb.back() == 3);
+}
+
+TEST_CASE("element access")
+{
+    jm::circular_buffer<int, 5> cb;
+    for(int i = 0; i < 7; ++i)
+        cb.push_back(i); // 23456
+
+    const auto& ccb = cb;
+    for(std::size_t i = 0; i < cb.size(); ++i) {
+        REQUIRE(cb[i] == static_cast<int>(i) + 2);
+        REQUIRE(ccb[i] == static_cast<int>(i) + 2);
+        REQUIRE(cb.at(i) == static_cast<int>(i) + 2);
+        REQUIRE(ccb.at(i) == static_cast<int>(i) + 2);
+    }
+
+    cb[0] = 10;
+    REQUIRE(cb.front() == 10);
+
+    cb.pop_back();
+    REQUIRE_THROWS_AS(cb.at(4), std::out_of_range);
+    REQUIRE_THROWS_AS(ccb.at(4), std::out_of_range);
+}
+
+TEST_CASE("contiguous segments")
+{
+    SECTION("empty")
+    {
+        jm::circular_buffer<int, 8> cb;
+        REQUIRE(cb.array_one().second == 0);
+        REQUIRE(cb.array_two().second == 0);
+        REQUIRE(cb.free_array_one().second + cb.free_array_two().second == 8);
+    }
+
+    SECTION("wrapped")
+    {
+        jm::circular_buffer<int, 5> cb;
+        for(int i = 0; i < 7; ++i)
+            cb.push_back(i); // 23456 wrapped around the end of the storage
+
+        const auto one = cb.array_one();
+        const auto two = cb.array_two();
+        REQUIRE(one.second != 0);
+        REQUIRE(two.second != 0);
+        REQUIRE(one.second + two.second == cb.size());
+
+        std::vector<int> joined(one.first, one.first + one.second);
+        joined.insert(joined.end(), two.first, two.first + two.second);
+        REQUIRE(std::equal(joined.begin(), joined.end(), cb.begin()));
+
+        const auto& ccb = cb;
+        REQUIRE(ccb.array_one().first == one.first);
+        REQUIRE(ccb.array_two().first == two.first);
+        REQUIRE(cb.free_array_one().second == 0);
+        REQUIRE(cb.free_array_two().second == 0);
+    }
+
+    SECTION("free space and commit_back")
+    {
+        jm::circular_buffer<int, 5> cb;
+        for(int i = 0; i < 4; ++i)
+            cb.push_back(i);
+        cb.pop_front();
+        cb.pop_front(); // 23
+
+        auto free_one = cb.free_array_one();
+        auto free_two = cb.free_array_two();
+        REQUIRE(free_one.second + free_two.second == 3);
+
+        const int incoming[] = { 4, 5, 6 };
+        std::memcpy(free_one.first, incoming, free_one.second * sizeof(int));
+        std::memcpy(free_two.first, incoming + free_one.second, free_two.second * sizeof(int));
+        cb.commit_back(3);
+
+        REQUIRE(cb.full());
+        REQUIRE(cb.front() == 2);
+        REQUIRE(cb.back() == 6);
+        for(int i = 0; i < 5; ++i)
+            REQUIRE(cb[i] == i + 2);
+    }
+
+    SECTION("commit_back into empty")
+    {
+        jm::circular_buffer<int, 4> cb(std::size_t(0), 1);
+        auto free_one = cb.free_array_one();
+        free_one.first[0] = 42;
+        cb.commit_back(1);
+        REQUIRE(cb.size() == 1);
+        REQUIRE(cb.front() == 42);
+        REQUIRE(cb.back() == 42);
+    }
+}
+
+TEST_CASE("segment iteration")
+{
+    jm::circular_buffer<int, 7> cb;
+    cb.append(inc_vec.data(), 10); // 3456789
+
+    SECTION("for_each_segment")
+    {
+        std::vector<int> seen;
+        int              calls = 0;
+        cb.for_each_segment([&](int* first, int* last) {
+            ++calls;
+            seen.insert(seen.end(), first, last);
+        });
+        REQUIRE(std::equal(seen.begin(), seen.end(), cb.begin()));
+        REQUIRE(seen.size() == cb.size());
+        REQUIRE(calls == (cb.array_two().second != 0 ? 2 : 1));
+
+        const auto& ccb = cb;
+        std::size_t count = 0;
+        ccb.for_each_segment([&](const int* first, const int* last) { count += last - first; });
+        REQUIRE(count == 7);
+
+        decltype(cb) empty;
+        empty.for_each_segment([&](int*, int*) { FAIL("called for an empty buffer"); });
+    }
+
+    SECTION("algorithm overloads")
+    {
+        std::vector<int> out;
+        copy(cb.begin(), cb.end(), std::back_inserter(out)); // found through ADL
+        REQUIRE(std::equal(out.begin(), out.end(), cb.begin()));
+
+        std::vector<int> partial(3);
+        jm::copy(cb.begin() + 2, cb.begin() + 5, partial.begin());
+        REQUIRE(partial == std::vector<int>{5, 6, 7});
+
+        for(int v : cb)
+            REQUIRE(*jm::find(cb.begin(), cb.end(), v) == v);
+        REQUIRE(jm::find(cb.begin(), cb.end(), 42) == cb.end());
+        REQUIRE(jm::find(cb.cbegin() + 1, cb.cend(), 3) == cb.cend());
+
+        jm::fill(cb.begin() + 1, cb.end() - 1, 0);
+        REQUIRE(cb.front() == 3);
+        REQUIRE(cb.back() == 9);
+        REQUIRE(std::count(cb.begin(), cb.end(), 0) == 5);
+    }
+}
+
+TEST_CASE("bulk operations")
+{
+    SECTION("append wraps around")
+    {
+        jm::circular_buffer<int, 5> cb;
+        cb.push_back(-2);
+        cb.push_back(-1);
+        cb.pop_front();
+        cb.append(inc_vec.data(), 3);
+        REQUIRE(cb.size() == 4);
+        REQUIRE(cb.front() == -1);
+        REQUIRE(cb.back() == 2);
+
+        cb.append(inc_vec.data() + 3, 3); // evicts the two oldest
+        REQUIRE(cb.full());
+        for(int i = 0; i < 5; ++i)
+            REQUIRE(cb[i] == i + 1);
+    }
+
+    SECTION("append more than N")
+    {
+        jm::circular_buffer<int, 16> cb = gen_filled_cb(3);
+        cb.append(inc_vec.data(), inc_vec.size());
+        REQUIRE(cb.full());
+        REQUIRE(std::equal(cb.begin(), cb.end(), inc_vec.end() - 16));
+    }
+
+    SECTION("push_back ranges")
+    {
+        std::list<int> l(inc_vec.begin(), inc_vec.begin() + 10);
+        jm::circular_buffer<int, 8> cb;
+        cb.push_back(l.begin(), l.end());
+        REQUIRE(cb.size() == 8);
+        REQUIRE(cb.front() == 2);
+        REQUIRE(cb.back() == 9);
+
+        std::istringstream         stream("10 11 12");
+        std::istream_iterator<int> first(stream), last;
+        cb.push_back(first, last);
+        REQUIRE(cb.front() == 5);
+        REQUIRE(cb.back() == 12);
+    }
+
+    SECTION("pop_front and copy_out")
+    {
+        jm::circular_buffer<int, 5> cb;
+        cb.append(inc_vec.data(), 7); // 23456
+
+        int out[8] = {};
+        REQUIRE(cb.copy_out(out, 8) == 5);
+        for(int i = 0; i < 5; ++i)
+            REQUIRE(out[i] == i + 2);
+
+        std::vector<int> v;
+        REQUIRE(cb.copy_out(std::back_inserter(v), 2) == 2);
+        REQUIRE(v == std::vector<int>{ 2, 3 });
+
+        cb.pop_front(3);
+        REQUIRE(cb.size() == 2);
+        REQUIRE(cb.front() == 5);
+        cb.pop_front(2);
+        REQUIRE(cb.empty());
+        cb.push_back(1);
+        REQUIRE(cb.front() == 1);
+        REQUIRE(cb.back() == 1);
+    }
+
+    SECTION("non trivial types")
+    {
+        const auto constructions = num_constructions;
+        const auto deletions     = num_deletions;
+        {
+            std::vector<leak_checker>           v(11);
+            jm::circular_buffer<leak_checker, 4> cb;
+            cb.push_back(v.begin(), v.begin() + 3);
+            cb.append(v.data() + 3, 8);
+            REQUIRE(cb.size() == 4);
+            cb.pop_front(3);
+            REQUIRE(cb.size() == 1);
+
+            std::vector<leak_checker> out(1);
+            REQUIRE(cb.copy_out(out.begin(), 4) == 1);
+        }
+        REQUIRE(num_constructions - constructions == num_deletions - deletions);
+    }
+}
+
+TEST_CASE("pop_back count and clear")
+{
+    SECTION("trivial")
+    {
+        jm::circular_buffer<int, 5> cb;
+        cb.append(inc_vec.data(), 8); // 34567
+        cb.pop_back(2);
+        REQUIRE(cb.size() == 3);
+        REQUIRE(cb.back() == 5);
+        REQUIRE(cb.front() == 3);
+        cb.pop_back(3);
+        REQUIRE(cb.empty());
+        cb.push_front(1);
+        REQUIRE(cb.front() == 1);
+        REQUIRE(cb.back() == 1);
+
+        cb.append(inc_vec.data(), 4);
+        cb.clear();
+        REQUIRE(cb.empty());
+        REQUIRE(cb.begin() == cb.end());
+        cb.push_back(2);
+        REQUIRE(cb.front() == 2);
+    }
+
+    SECTION("non trivial")
+    {
+        const auto constructions = num_constructions;
+        const auto deletions     = num_deletions;
+        {
+            jm::circular_buffer<leak_checker, 4> cb;
+            for(int i = 0; i < 6; ++i)
+                cb.emplace_back();
+            cb.pop_back(2);
+            REQUIRE(cb.size() == 2);
+            REQUIRE(num_constructions - constructions == num_deletions - deletions + 2);
+            cb.clear();
+            REQUIRE(num_constructions - constructions == num_deletions - deletions);
+            cb.emplace_back();
+            cb.emplace_back();
+        }
+        REQUIRE(num_constructions - constructions == num_deletions - deletions);
+    }
+}
+
+TEST_CASE("dynamic_circular_buffer")
+{
+    SECTION("behaves like circular_buffer")
+    {
+        jm::dynamic_circular_buffer<int> cb(5);
+        REQUIRE(cb.capacity() == 5);
+        REQUIRE(cb.empty());
+
+        cb.append(inc_vec.data(), 8); // 34567
+        REQUIRE(cb.full());
+        REQUIRE(std::equal(cb.begin(), cb.end(), inc_vec.begin() + 3));
+        cb.push_back(8);
+        cb.push_front(2);
+        REQUIRE(cb.front() == 2);
+        REQUIRE(cb.back() == 7);
+        REQUIRE(cb.array_one().second + cb.array_two().second == 5);
+        REQUIRE(cb.end() - cb.begin() == 5);
+
+        jm::dynamic_circular_buffer<int> list{1, 2, 3};
+        REQUIRE(list.capacity() == 3);
+        REQUIRE(list.back() == 3);
+    }
+
+    SECTION("no capacity")
+    {
+        jm::dynamic_circular_buffer<int> cb;
+        REQUIRE(cb.capacity() == 0);
+        REQUIRE(cb.begin() == cb.end());
+
+        // pushes do nothing instead of writing into the shared empty slot
+        jm::dynamic_circular_buffer<std::string> strings;
+        strings.push_back("a");
+        strings.push_front(std::string("b"));
+        strings.emplace_back("c");
+        strings.emplace_front("d");
+        std::string evicted = "e";
+        REQUIRE_FALSE(strings.push_back_overwrite("f", evicted));
+        REQUIRE_FALSE(strings.push_front_overwrite(std::string("g"), evicted));
+        REQUIRE_FALSE(strings.try_push_back("h"));
+        REQUIRE(strings.empty());
+        REQUIRE(evicted == "e");
+        REQUIRE(strings.begin() == strings.end());
+        cb.reserve(2);
+        cb.push_back(1);
+        cb.push_back(2);
+        cb.push_back(3);
+        REQUIRE(cb.front() == 2);
+    }
+
+    SECTION("set_capacity keeps the front")
+    {
+        jm::dynamic_circular_buffer<int> cb(4);
+        cb.append(inc_vec.data(), 6); // 2345
+        cb.set_capacity(6);
+        REQUIRE(cb.capacity() == 6);
+        REQUIRE(std::equal(cb.begin(), cb.end(), inc_vec.begin() + 2));
+        cb.push_back(6);
+        cb.push_back(7);
+        cb.push_back(8);
+        REQUIRE(cb.front() == 3);
+
+        cb.set_capacity(2); // 34
+        REQUIRE(cb.size() == 2);
+        REQUIRE(cb.front() == 3);
+        REQUIRE(cb.back() == 4);
+
+        cb.reserve(1);
+        REQUIRE(cb.capacity() == 2);
+        cb.pop_back();
+        cb.shrink_to_fit();
+        REQUIRE(cb.capacity() == 1);
+        REQUIRE(cb.front() == 3);
+    }
+
+    SECTION("copy and move")
+    {
+        const auto constructions = num_constructions;
+        const auto deletions     = num_deletions;
+        {
+            jm::dynamic_circular_buffer<leak_checker> cb(3);
+            for(int i = 0; i < 5; ++i)
+                cb.emplace_back();
+
+            auto copy = cb;
+            REQUIRE(copy.size() == 3);
+            REQUIRE(copy.capacity() == 3);
+
+            jm::dynamic_circular_buffer<leak_checker> other(8);
+            other.emplace_back();
+            other = copy;
+            REQUIRE(other.capacity() == 3);
+            REQUIRE(other.size() == 3);
+
+            auto moved = std::move(cb);
+            REQUIRE(moved.size() == 3);
+            REQUIRE(cb.capacity() == 0);
+
+            other = std::move(moved);
+            REQUIRE(other.size() == 3);
+            swap(other, cb);
+            REQUIRE(cb.size() == 3);
+            REQUIRE(other.empty());
+
+            cb.set_capacity(5);
+            cb.emplace_back();
+            REQUIRE(cb.size() == 4);
+        }
+        REQUIRE(num_constructions - constructions == num_deletions - deletions);
+    }
+
+#if defined(__cpp_lib_memory_resource)
+    SECTION("polymorphic allocator")
+    {
+        unsigned char                       arena[256];
+        std::pmr::monotonic_buffer_resource resource(arena, sizeof(arena));
+
+        jm::pmr::dynamic_circular_buffer<int> cb(16, &resource);
+        cb.append(inc_vec.data(), 20);
+        REQUIRE(cb.front() == 4);
+        REQUIRE(reinterpret_cast<unsigned char*>(cb.data()) >= arena);
+        REQUIRE(reinterpret_cast<unsigned char*>(cb.data()) < arena + sizeof(arena));
+    }
+#endif
+}
+
+TEST_CASE("segment algorithms")
+{
+    SECTION("float windows of every fill level")
+    {
+        jm::circular_buffer<float, 37> cb;
+        std::vector<float>             weights(37);
+        std::iota(weights.begin(), weights.end(), 1.f);
+
+        for(int i = 0; i < 100; ++i) {
+            cb.push_back(static_cast<float>((i * 7) % 23));
+
+            // small integers keep the float arithmetic exact regardless of order
+            REQUIRE(jm::cb::accumulate(cb) == std::accumulate(cb.begin(), cb.end(), 0.f));
+            REQUIRE(jm::cb::dot(cb, weights.data()) ==
+                    std::inner_product(cb.begin(), cb.end(), weights.begin(), 0.f));
+
+            const auto mm = jm::cb::minmax(cb);
+            REQUIRE(mm.first == *std::min_element(cb.begin(), cb.end()));
+            REQUIRE(mm.second == *std::max_element(cb.begin(), cb.end()));
+        }
+    }
+
+    SECTION("double and scalar fallback")
+    {
+        jm::circular_buffer<double, 8> cb;
+        cb.append(std::vector<double>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}.data(), 10);
+        REQUIRE(jm::cb::accumulate(cb, 1.) == 53.);
+        REQUIRE(jm::cb::mean(cb) == 6.5);
+
+        jm::circular_buffer<int, 5> ints;
+        ints.append(inc_vec.data(), 8); // 34567
+        REQUIRE(jm::cb::accumulate(ints) == 25);
+        REQUIRE(jm::cb::minmax(ints) == std::make_pair(3, 7));
+    }
+
+    SECTION("transform_inplace")
+    {
+        jm::dynamic_circular_buffer<float> cb(6);
+        for(int i = 0; i < 9; ++i)
+            cb.push_back(static_cast<float>(i));
+
+        jm::cb::transform_inplace(cb, [](float v) { return v * 2.f; });
+        REQUIRE(cb.front() == 6.f);
+        REQUIRE(cb.back() == 16.f);
+        REQUIRE(jm::cb::accumulate(cb) == 66.f);
+    }
+}
+
+TEST_CASE("rolling_circular_buffer")
+{
+    SECTION("aggregates follow the window")
+    {
+        jm::rolling_circular_buffer<int, 5, jm::rolling_moments, jm::rolling_min, jm::rolling_max>
+            rb;
+
+        // a sequence that rises and falls so that the extremes get evicted
+        for(int i = 0; i < 200; ++i) {
+            rb.push_back((i * 37) % 17 - 8);
+
+            REQUIRE(rb.count() == rb.size());
+            REQUIRE(rb.sum() == std::accumulate(rb.begin(), rb.end(), 0));
+            REQUIRE(rb.sum_of_squares() ==
+                    std::inner_product(rb.begin(), rb.end(), rb.begin(), 0));
+            REQUIRE(rb.min() == *std::min_element(rb.begin(), rb.end()));
+            REQUIRE(rb.max() == *std::max_element(rb.begin(), rb.end()));
+        }
+
+        rb.pop_front();
+        rb.pop_front();
+        REQUIRE(rb.size() == 3);
+        REQUIRE(rb.min() == *std::min_element(rb.begin(), rb.end()));
+        REQUIRE(rb.max() == *std::max_element(rb.begin(), rb.end()));
+
+        rb.clear();
+        REQUIRE(rb.count() == 0);
+        rb.emplace_back(4);
+        REQUIRE(rb.min() == 4);
+        REQUIRE(rb.max() == 4);
+        REQUIRE(rb.mean() == 4);
+    }
+
+    SECTION("duplicates and moments")
+    {
+        jm::rolling_circular_buffer<double, 3, jm::rolling_sum, jm::rolling_min> rb{
+            2., 1., 1., 3.};
+        REQUIRE(rb.sum() == 5.);
+        REQUIRE(rb.min() == 1.);
+        rb.push_back(5.);
+        REQUIRE(rb.min() == 1.);
+        rb.push_back(6.);
+        REQUIRE(rb.min() == 3.);
+
+        jm::rolling_circular_buffer<double, 4, jm::rolling_moments> moments{1., 2., 3., 4.};
+        REQUIRE(moments.mean() == 2.5);
+        REQUIRE(moments.variance() == 1.25);
+    }
+
+    SECTION("order statistics")
+    {
+        jm::rolling_circular_buffer<unsigned, 16, jm::rolling_order_statistics> rb;
+
+        // few distinct values so that the window holds duplicates
+        std::uint32_t x = 12345;
+        for(int i = 0; i < 300; ++i) {
+            x = x * 1103515245u + 12345u;
+            rb.push_back((x >> 16) % 23);
+
+            std::vector<unsigned> sorted(rb.begin(), rb.end());
+            std::sort(sorted.begin(), sorted.end());
+            for(std::size_t k = 0; k < sorted.size(); ++k)
+                REQUIRE(rb.select(k) == sorted[k]);
+            for(unsigned v = 0; v < 25; ++v)
+                REQUIRE(rb.rank(v) == static_cast<std::size_t>(
+                                          std::lower_bound(sorted.begin(), sorted.end(), v) -
+                                          sorted.begin()));
+
+            REQUIRE(rb.quantile(0.) == sorted.front());
+            REQUIRE(rb.quantile(1.) == sorted.back());
+        }
+
+        rb.clear();
+        for(unsigned v = 1; v <= 10; ++v)
+            rb.push_back(v * 10);
+        REQUIRE(rb.quantile(0.5) == 50);
+        REQUIRE(rb.quantile(0.51) == 60);
+        REQUIRE(rb.quantile(0.99) == 100);
+        REQUIRE(rb.rank(55) == 5);
+
+        rb.pop_front();
+        rb.pop_front();
+        REQUIRE(rb.select(0) == 30);
+        REQUIRE(rb.quantile(0.5) == 60);
+    }
+}
+
+TEST_CASE("timed_circular_buffer")
+{
+    SECTION("expiry and ranges")
+    {
+        jm::timed_circular_buffer<int, 8, int> tb;
+        REQUIRE(tb.expire_before(100) == 0);
+        REQUIRE(tb.range(0, 100).empty());
+
+        // values 0..11 stamped 10 apart, the first 4 get overwritten
+        for(int i = 0; i < 12; ++i)
+            tb.push_back(i * 10, i);
+        REQUIRE(tb.full());
+        REQUIRE(tb.front() == 4);
+        REQUIRE(tb.front_timestamp() == 40);
+        REQUIRE(tb.back_timestamp() == 110);
+        REQUIRE(tb.timestamp(2) == 60);
+
+        REQUIRE(tb.lower_bound(0) == 0);
+        REQUIRE(tb.lower_bound(55) == 2);
+        REQUIRE(tb.lower_bound(200) == 8);
+
+        // the range wraps around the end of the slots
+        const auto r = tb.range(45, 105);
+        REQUIRE(r.size() == 6);
+        REQUIRE(*r.one.first == 5);
+        std::vector<int> values(r.one.first, r.one.first + r.one.second);
+        values.insert(values.end(), r.two.first, r.two.first + r.two.second);
+        REQUIRE(values == (std::vector<int>{5, 6, 7, 8, 9, 10}));
+        REQUIRE(tb.range(105, 45).empty());
+
+        const auto& ctb = tb;
+        REQUIRE(ctb.range(110, 111).size() == 1);
+
+        REQUIRE(tb.expire_before(75) == 4);
+        REQUIRE(tb.size() == 4);
+        REQUIRE(tb.front() == 8);
+        REQUIRE(tb.front_timestamp() == 80);
+        REQUIRE(tb.values().size() == tb.timestamps().size());
+
+        // equal timestamps stay together
+        tb.emplace_back(110, 12);
+        REQUIRE(tb.expire_before(110) == 3);
+        REQUIRE(tb.size() == 2);
+
+        tb.clear();
+        REQUIRE(tb.empty());
+    }
+
+    SECTION("clock timestamps")
+    {
+        typedef std::chrono::steady_clock clock;
+        jm::timed_circular_buffer<std::string, 4> events;
+        const clock::time_point start = clock::now();
+        events.push_back(start, "a");
+        events.push_back(start + std::chrono::seconds(1), "b");
+        events.push_back(start + std::chrono::seconds(6), "c");
+
+        REQUIRE(events.expire_before(events.back_timestamp() - std::chrono::seconds(4)) == 2);
+        REQUIRE(events.front() == "c");
+    }
+}
+
+TEST_CASE("soa_circular_buffer")
+{
+    // price, qty, ts, flags
+    typedef jm::soa_circular_buffer<6, double, int, std::uint64_t, unsigned char> ticks_t;
+    static_assert(std::is_same<ticks_t::field_type<2>, std::uint64_t>::value, "");
+    static_assert(alignof(ticks_t) == JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE, "");
+
+    ticks_t ticks;
+    REQUIRE(ticks.empty());
+    REQUIRE(ticks.begin<0>() == ticks.end<0>());
+
+    for(int i = 0; i < 9; ++i)
+        ticks.push_back(i * 1.5, i, static_cast<std::uint64_t>(100 + i), static_cast<unsigned char>(i & 1));
+
+    REQUIRE(ticks.full());
+    REQUIRE(ticks.front<1>() == 3);
+    REQUIRE(ticks.back<2>() == 108);
+    REQUIRE(ticks.get<0>(1) == 6.);
+    REQUIRE(ticks.get<3>(5) == 0);
+    REQUIRE_FALSE(ticks.try_push_back(0., 0, 0, 0));
+
+    // the lanes wrap at the same place
+    const auto price_one = ticks.array_one<0>();
+    const auto qty_one   = ticks.array_one<1>();
+    REQUIRE(price_one.second == 2);
+    REQUIRE(qty_one.second == 2);
+    REQUIRE(*qty_one.first == 3);
+    REQUIRE(ticks.array_two<2>().second == 4);
+    REQUIRE(*ticks.array_two<2>().first == 105);
+
+    double total = 0;
+    ticks.for_each_segment<0>([&](const double* first, const double* last) {
+        total = std::accumulate(first, last, total);
+    });
+    REQUIRE(total == 1.5 * (3 + 4 + 5 + 6 + 7 + 8));
+
+    REQUIRE(std::accumulate(ticks.begin<1>(), ticks.end<1>(), 0) == 33);
+    REQUIRE(ticks.end<1>() - ticks.begin<1>() == 6);
+    *ticks.begin<1>() = 30;
+    REQUIRE(ticks.front<1>() == 30);
+
+    ticks.pop_front(2);
+    ticks.pop_back();
+    REQUIRE(ticks.size() == 3);
+    REQUIRE(ticks.front<2>() == 105);
+    REQUIRE(ticks.back<2>() == 107);
+    REQUIRE(ticks.try_push_back(20., 20, 200, 1));
+    REQUIRE(ticks.back<0>() == 20.);
+
+    const ticks_t& cticks = ticks;
+    REQUIRE(std::vector<int>(cticks.begin<1>(), cticks.end<1>()) == (std::vector<int>{5, 6, 7, 20}));
+
+    ticks.clear();
+    REQUIRE(ticks.empty());
+    ticks.push_back(1., 1, 1, 1);
+    REQUIRE(ticks.array_one<3>().second == 1);
+}
+
+TEST_CASE("serialization")
+{
+    struct sample {
+        std::uint16_t channel;
+        double        value;
+    };
+
+    // wrapped around, so the snapshot has to put the two segments in order
+    jm::circular_buffer<sample, 5> cb;
+    for(int i = 0; i < 8; ++i)
+        cb.push_back(sample{static_cast<std::uint16_t>(i), i * 0.5});
+
+    // 24 bytes of header followed by the elements
+    const std::size_t size = jm::serialized_size(cb);
+    REQUIRE(size == 24 + 5 * sizeof(sample));
+
+    // snapshots written back to back, the storage keeps them aligned for viewing
+    std::vector<std::uint64_t> storage(4 * size / sizeof(std::uint64_t));
+    char*                      bytes  = reinterpret_cast<char*>(storage.data());
+    std::size_t                offset = jm::serialize(cb, bytes);
+    REQUIRE(offset == size);
+
+    jm::circular_buffer<sample, 5> small;
+    small.push_back(sample{42, 1.0});
+    small.push_back(sample{43, 2.0});
+    small.pop_front();
+    offset += jm::serialize(small, bytes + offset);
+
+    jm::dynamic_circular_buffer<int> ints(3);
+    ints.push_back(7);
+    const std::size_t ints_offset = offset;
+    offset += jm::serialize(ints, bytes + offset);
+    REQUIRE(offset % 8 == 0);
+
+    SECTION("deserialize")
+    {
+        jm::circular_buffer<sample, 5> restored;
+        restored.push_back(sample{9, 9.0});
+        REQUIRE(jm::deserialize(restored, bytes, offset) == size);
+        REQUIRE(restored.size() == 5);
+        for(std::size_t i = 0; i < 5; ++i) {
+            REQUIRE(restored[i].channel == cb[i].channel);
+            REQUIRE(restored[i].value == cb[i].value);
+        }
+
+        // into a buffer whose free slots wrap around
+        restored.pop_front(4);
+        restored.push_back(sample{1, 1.0});
+        REQUIRE(jm::deserialize(restored, bytes + size, offset - size) ==
+                jm::serialized_size(small));
+        REQUIRE(restored.size() == 1);
+        REQUIRE(restored.front().channel == 43);
+
+        jm::dynamic_circular_buffer<int> dynamic;
+        jm::deserialize(dynamic, bytes + ints_offset, offset - ints_offset);
+        REQUIRE(dynamic.capacity() == 3);
+        REQUIRE(dynamic.size() == 1);
+        REQUIRE(dynamic.front() == 7);
+    }
+
+    SECTION("view")
+    {
+        jm::circular_buffer_view<sample> view(bytes, offset);
+        REQUIRE(view.size() == 5);
+        REQUIRE(view.capacity() == 5);
+        REQUIRE(view.full());
+        REQUIRE(view.front().channel == 3);
+        REQUIRE(view.back().channel == 7);
+        REQUIRE(view.array_one().second == 5);
+        REQUIRE(view.array_two().second == 0);
+        REQUIRE(reinterpret_cast<const char*>(view.begin()) == bytes + 24);
+        REQUIRE(std::equal(view.begin(), view.end(), cb.begin(), [](const sample& a, const sample& b) {
+            return a.channel == b.channel && a.value == b.value;
+        }));
+        REQUIRE_THROWS_AS(view.at(5), std::out_of_range);
+
+        jm::circular_buffer_view<sample> next(bytes + view.serialized_size(),
+                                              offset - view.serialized_size());
+        REQUIRE(next.size() == 1);
+        REQUIRE(next.at(0).channel == 43);
+
+        jm::circular_buffer_view<int> last(bytes + ints_offset, offset - ints_offset);
+        REQUIRE(jm::cb::accumulate(last) == 7);
+    }
+
+    SECTION("invalid snapshots")
+    {
+        jm::circular_buffer<sample, 5> restored;
+        restored.push_back(sample{9, 9.0});
+
+        jm::circular_buffer<sample, 6> other_capacity;
+        REQUIRE_THROWS_AS(jm::deserialize(other_capacity, bytes, offset), std::runtime_error);
+        REQUIRE_THROWS_AS(jm::deserialize(restored, bytes, size - 1), std::runtime_error);
+        REQUIRE_THROWS_AS(jm::deserialize(restored, bytes, 10), std::runtime_error);
+        REQUIRE_THROWS_AS(jm::circular_buffer_view<int>(bytes, offset), std::runtime_error);
+        REQUIRE_THROWS_AS(jm::circular_buffer_view<sample>(bytes + 8, offset - 8),
+                          std::runtime_error);
+        REQUIRE(restored.size() == 1);
+
+        // readable again from an unaligned copy
+        std::vector<char> unaligned(size + 1);
+        std::memcpy(unaligned.data() + 1, bytes, size);
+        REQUIRE_THROWS_AS(jm::circular_buffer_view<sample>(unaligned.data() + 1, size),
+                          std::runtime_error);
+        REQUIRE(jm::deserialize(restored, unaligned.data() + 1, size) == size);
+        REQUIRE(restored.back().channel == 7);
+
+        // a corrupted capacity leaves a dynamic buffer unchanged
+        jm::dynamic_circular_buffer<int> dynamic(2);
+        dynamic.push_back(1);
+        std::vector<char>   corrupted(bytes + ints_offset, bytes + offset);
+        const std::uint64_t huge = UINT64_MAX / 2;
+        std::memcpy(corrupted.data() + offsetof(jm::detail::cb_snapshot_header, capacity),
+                    &huge,
+                    sizeof(huge));
+        REQUIRE_THROWS_AS(jm::deserialize(dynamic, corrupted.data(), corrupted.size()),
+                          std::runtime_error);
+        REQUIRE_THROWS_AS(jm::deserialize(dynamic, bytes + ints_offset, 10), std::runtime_error);
+        REQUIRE(dynamic.capacity() == 2);
+        REQUIRE(dynamic.size() == 1);
+        REQUIRE(dynamic.front() == 1);
+    }
+}
+
+TEST_CASE("cache line alignment")
+{
+    typedef jm::circular_buffer<float, 10, 64> aligned_t;
+    static_assert(alignof(aligned_t) == 64, "");
+    static_assert(sizeof(aligned_t) == 128, "");
+    static_assert(jm::cache_line_capacity<float, 10>::value == 16, "");
+    static_assert(jm::cache_line_capacity<float, 16>::value == 16, "");
+    static_assert(jm::cache_line_capacity<char, 100, 128>::value == 128, "");
+
+    // the elements take the first line, the indices the second
+    aligned_t buffers[2];
+    for(auto& cb : buffers) {
+        REQUIRE(reinterpret_cast<std::uintptr_t>(&cb) % 64 == 0);
+        for(int i = 0; i < 15; ++i)
+            cb.push_back(static_cast<float>(i));
+    }
+
+    REQUIRE(buffers[0].front() == 5.f);
+    REQUIRE(buffers[1].back() == 14.f);
+
+    aligned_t copy = buffers[0];
+    REQUIRE(std::equal(copy.begin(), copy.end(), buffers[0].begin()));
+    copy = std::move(buffers[1]);
+    REQUIRE(copy.size() == 10);
+
+    // exactly full lines still keep the indices off them
+    typedef jm::circular_buffer<float, 16, 64> full_line_t;
+    static_assert(sizeof(full_line_t) == 128, "");
+}
+
+TEST_CASE("streaming buffers")
+{
+    typedef jm::circular_buffer<int, 1000, 64, jm::streaming<32>>           streaming_t;
+    typedef jm::circular_buffer<std::string, 100, 0, jm::streaming<8>>      strings_t;
+    typedef jm::circular_buffer<int, 1000, 0, jm::streaming<0, true>>       stores_only_t;
+    typedef jm::circular_buffer<int, 1000>                                  plain_t;
+    static_assert(std::is_same<plain_t, jm::circular_buffer<int, 1000, 0, jm::no_streaming>>::value,
+                  "");
+    static_assert(jm::is_trivially_relocatable<streaming_t>::value, "");
+
+    // the hints must not change what the buffers hold, odd sizes leave the
+    // non temporal stores unaligned heads and tails
+    std::vector<int> src(2500);
+    std::iota(src.begin(), src.end(), 0);
+
+    auto run = [&src](auto& cb) {
+        std::size_t offset = 0;
+        for(std::size_t count : {1u, 7u, 333u, 999u, 1000u, 1160u}) {
+            cb.append(src.data() + offset % 100, count);
+            for(int i = 0; i < 13; ++i)
+                cb.push_back(static_cast<int>(offset) + i);
+            cb.pop_front();
+            cb.pop_front(cb.size() / 3);
+            offset += count;
+        }
+        std::vector<int> out(cb.begin(), cb.end());
+        return out;
+    };
+
+    auto streaming = make_aligned<streaming_t>();
+    auto stores    = make_aligned<stores_only_t>();
+    auto plain     = std::unique_ptr<plain_t>(new plain_t());
+    const std::vector<int> expected = run(*plain);
+    REQUIRE(expected.size() == plain->size());
+    REQUIRE(run(*streaming) == expected);
+    REQUIRE(run(*stores) == expected);
+
+    strings_t strings;
+    for(int i = 0; i < 250; ++i)
+        strings.emplace_back(std::to_string(i));
+    while(strings.size() > 1)
+        strings.pop_front();
+    REQUIRE(strings.front() == "249");
+}
+
+// owns an allocation, so it can be relocated by copying its bytes but is not
+// trivially copyable
+struct relocatable_box {
+    static int alive;
+
+    std::unique_ptr<int> value;
+
+    explicit relocatable_box(int v) : value(new int(v)) { ++alive; }
+    relocatable_box(relocatable_box&& other) noexcept : value(std::move(other.value))
+    {
+        ++alive;
+    }
+    ~relocatable_box() { --alive; }
+};
+
+int relocatable_box::alive = 0;
+
+namespace jm {
+    template<>
+    struct is_trivially_relocatable<relocatable_box> : std::true_type {
+    };
+} // namespace jm
+
+TEST_CASE("trivially copyable buffers")
+{
+    typedef jm::circular_buffer<int, 8> int_buffer;
+    static_assert(std::is_trivially_copyable<int_buffer>::value, "");
+    static_assert(std::is_trivially_destructible<int_buffer>::value, "");
+    static_assert(std::is_trivially_copyable<jm::circular_buffer<float, 10, 64>>::value, "");
+    static_assert(!std::is_trivially_copyable<jm::circular_buffer<std::string, 8>>::value, "");
+    static_assert(!std::is_trivially_copyable<jm::dynamic_circular_buffer<int>>::value, "");
+
+    static_assert(jm::is_trivially_relocatable<int_buffer>::value, "");
+    static_assert(jm::is_trivially_relocatable<jm::dynamic_circular_buffer<std::string>>::value, "");
+    static_assert(jm::is_trivially_relocatable<jm::circular_buffer<relocatable_box, 4>>::value, "");
+    static_assert(!jm::is_trivially_relocatable<jm::circular_buffer<std::string, 8>>::value, "");
+
+    SECTION("copies of the bytes are copies of the buffer")
+    {
+        int_buffer cb;
+        cb.append(inc_vec.data(), 11); // 3..10 wrapped around
+
+        int_buffer copy;
+        std::memcpy(static_cast<void*>(&copy), &cb, sizeof(cb));
+        REQUIRE(copy.size() == 8);
+        REQUIRE(std::equal(copy.begin(), copy.end(), inc_vec.begin() + 3));
+        copy.push_back(11);
+        REQUIRE(copy.front() == 4);
+        REQUIRE(cb.front() == 3);
+
+        std::vector<int_buffer> buffers(1, cb);
+        buffers.resize(16);
+        REQUIRE(std::equal(buffers[0].begin(), buffers[0].end(), cb.begin()));
+        REQUIRE(buffers[1].empty());
+
+        cb = copy;
+        REQUIRE(cb.back() == 11);
+    }
+
+    SECTION("relocatable elements are moved by their bytes")
+    {
+        {
+            jm::dynamic_circular_buffer<relocatable_box> cb(4);
+            for(int i = 0; i < 6; ++i)
+                cb.emplace_back(i); // 2345
+            REQUIRE(relocatable_box::alive == 4);
+
+            cb.set_capacity(8);
+            REQUIRE(relocatable_box::alive == 4);
+            REQUIRE(*cb.front().value == 2);
+            REQUIRE(*cb.back().value == 5);
+
+            cb.set_capacity(2); // 23
+            REQUIRE(relocatable_box::alive == 2);
+            REQUIRE(*cb.front().value == 2);
+            REQUIRE(*cb.back().value == 3);
+        }
+        REQUIRE(relocatable_box::alive == 0);
+    }
+}
+
+#if defined(JM_CIRCULAR_BUFFER_CXX20)
+
+namespace {
+
+    // not trivial in any way, so that nothing gets lowered to memcpy
+    struct constexpr_value {
+        int value;
+
+        constexpr constexpr_value(int v) : value(v) {}
+        constexpr constexpr_value(const constexpr_value& other) : value(other.value) {}
+        constexpr constexpr_value& operator=(const constexpr_value& other)
+        {
+            value = other.value;
+            return *this;
+        }
+        constexpr ~constexpr_value() {}
+    };
+
+    constexpr int constexpr_window()
+    {
+        jm::circular_buffer<constexpr_value, 4> cb;
+        for(int i = 0; i < 6; ++i)
+            cb.emplace_back(i);
+        cb.push_front(constexpr_value(9));
+        cb.pop_back();
+
+        jm::circular_buffer<constexpr_value, 4> copy  = cb;
+        jm::circular_buffer<constexpr_value, 4> moved = std::move(copy);
+        copy                                          = moved;
+        moved                                         = std::move(copy);
+
+        constexpr_value evicted(0);
+        moved.push_back_overwrite(constexpr_value(100), evicted);
+        if(moved.try_push_back(constexpr_value(1)))
+            return -1;
+
+        int sum = 0;
+        for(const auto& v : moved)
+            sum += v.value;
+        return sum;
+    }
+
+    constexpr int constexpr_bulk()
+    {
+        const int                   src[] = {1, 2, 3};
+        jm::circular_buffer<int, 5> cb(src, src + 3);
+        cb.append(src, 3);
+
+        int dest[5] = {};
+        jm::copy(cb.begin(), cb.end(), dest);
+        jm::fill(cb.begin(), cb.begin() + 2, 0);
+
+        jm::circular_buffer<std::string, 2> strings{"a", "b"};
+        strings.emplace_back("c");
+
+        return dest[0] * 10000 + dest[4] * 1000 + (jm::find(cb.begin(), cb.end(), 2) - cb.begin()) * 100 +
+               static_cast<int>(strings.front().size() + strings.back().size());
+    }
+
+} // namespace
+
+#endif // defined(JM_CIRCULAR_BUFFER_CXX20)
+
+TEST_CASE("constexpr in c++20")
+{
+#if defined(JM_CIRCULAR_BUFFER_CXX20)
+    static_assert(constexpr_window() == 9 + 2 + 3 + 100, "");
+    static_assert(constexpr_bulk() == 2 * 10000 + 3 * 1000 + 3 * 100 + 2, "");
+    REQUIRE(constexpr_window() == 114);
+#else
+    SUCCEED("needs JM_CIRCULAR_BUFFER_CXX20");
+#endif
+}
+
+#if defined(JM_CB_TEST_COROUTINES)
+
+namespace {
+
+    // runs eagerly and destroys itself when done, the tests keep their results in
+    // captured locals
+    struct detached_task {
+        struct promise_type {
+            detached_task       get_return_object() noexcept { return {}; }
+            std::suspend_never  initial_suspend() noexcept { return {}; }
+            std::suspend_never  final_suspend() noexcept { return {}; }
+            void                return_void() noexcept {}
+            void                unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+
+    template<std::size_t N>
+    detached_task produce(jm::async_circular_buffer<int, N>& channel, int count, int& pushed)
+    {
+        for(int i = 0; i < count; ++i)
+            if(co_await channel.push(i))
+                ++pushed;
+        channel.close();
+    }
+
+    template<std::size_t N>
+    detached_task consume(jm::async_circular_buffer<int, N>& channel, std::vector<int>& out)
+    {
+        while(std::optional<int> value = co_await channel.pop())
+            out.push_back(*value);
+    }
+
+    template<std::size_t N>
+    detached_task consume_n(jm::async_circular_buffer<int, N>& channel,
+                            std::vector<int>&                  out,
+                            std::vector<std::size_t>&          batches)
+    {
+        int values[3];
+        while(std::size_t count = co_await channel.pop_n(values, 3)) {
+            batches.push_back(count);
+            out.insert(out.end(), values, values + count);
+        }
+    }
+
+} // namespace
+
+#endif // defined(JM_CB_TEST_COROUTINES)
+
+TEST_CASE("async_circular_buffer")
+{
+#if defined(JM_CB_TEST_COROUTINES)
+    std::vector<int> expected(10);
+    std::iota(expected.begin(), expected.end(), 0);
+
+    SECTION("consumer waits for the producer")
+    {
+        jm::async_circular_buffer<int, 4> channel;
+        std::vector<int>                  out;
+        int                               pushed = 0;
+
+        consume(channel, out);
+        REQUIRE(out.empty());
+        produce(channel, 10, pushed);
+
+        REQUIRE(pushed == 10);
+        REQUIRE(out == expected);
+        REQUIRE(channel.closed());
+        REQUIRE(channel.empty());
+    }
+
+    SECTION("producer waits for the consumer")
+    {
+        jm::async_circular_buffer<int, 4> channel;
+        std::vector<int>                  out;
+        int                               pushed = 0;
+
+        produce(channel, 10, pushed);
+        REQUIRE(pushed == 4);
+        REQUIRE(channel.size() == 4);
+        consume(channel, out);
+
+        REQUIRE(pushed == 10);
+        REQUIRE(out == expected);
+    }
+
+    SECTION("bulk pops")
+    {
+        jm::async_circular_buffer<int, 4> channel;
+        std::vector<int>                  out;
+        std::vector<std::size_t>          batches;
+        int                               pushed = 0;
+
+        produce(channel, 10, pushed);
+        consume_n(channel, out, batches);
+
+        REQUIRE(out == expected);
+        REQUIRE(batches.front() == 3);
+        REQUIRE(std::accumulate(batches.begin(), batches.end(), std::size_t(0)) == 10);
+
+        int value;
+        REQUIRE_THROWS_AS(channel.pop_n(&value, 0), std::invalid_argument);
+    }
+
+    SECTION("close wakes waiters")
+    {
+        jm::async_circular_buffer<int, 2> channel;
+        std::vector<int>                  out;
+        consume(channel, out);
+        channel.close();
+        REQUIRE(out.empty());
+
+        int pushed = 0;
+        produce(channel, 3, pushed);
+        REQUIRE(pushed == 0);
+
+        jm::async_circular_buffer<int, 2> full;
+        produce(full, 3, pushed);
+        REQUIRE(pushed == 2);
+        consume(full, out);
+        REQUIRE(pushed == 3);
+        REQUIRE(out == std::vector<int>{0, 1, 2});
+    }
+
+    SECTION("try_push and try_pop")
+    {
+        jm::async_circular_buffer<int, 2> channel;
+        REQUIRE(channel.capacity() == 2);
+        REQUIRE(!channel.try_pop());
+        REQUIRE(channel.try_push(1));
+        REQUIRE(channel.try_push(2));
+        REQUIRE(!channel.try_push(3));
+        REQUIRE(*channel.try_pop() == 1);
+
+        std::vector<int> out;
+        consume(channel, out);
+        REQUIRE(out == std::vector<int>{2});
+        REQUIRE(channel.try_push(4));
+        REQUIRE(out == std::vector<int>{2, 4});
+
+        channel.close();
+        REQUIRE(!channel.try_push(5));
+    }
+
+    SECTION("threads")
+    {
+        jm::async_circular_buffer<int, 8> channel;
+        std::vector<int>                  out;
+        consume(channel, out);
+
+        std::vector<std::thread> threads;
+        for(int t = 0; t < 4; ++t)
+            threads.emplace_back([&channel, t] {
+                for(int i = 0; i < 1000; ++i)
+                    while(!channel.try_push(t * 1000 + i))
+                        std::this_thread::yield();
+            });
+        for(auto& thread : threads)
+            thread.join();
+        channel.close();
+
+        REQUIRE(out.size() == 4000);
+        std::sort(out.begin(), out.end());
+        for(int i = 0; i < 4000; ++i)
+            REQUIRE(out[i] == i);
+    }
+#else
+    SUCCEED("needs c++20 coroutines");
+#endif
+}
+
+#if defined(JM_CB_TEST_POSIX)
+
+TEST_CASE("mapped_circular_buffer")
+{
+    const char* path = "mapped_circular_buffer_test.bin";
+    std::remove(path);
+
+    {
+        jm::mapped_circular_buffer<long> cb(path, 5);
+        REQUIRE(cb.empty());
+        REQUIRE(cb.capacity() == 5);
+        for(long i = 0; i < 8; ++i)
+            cb.push_back(i);
+
+        REQUIRE(cb.full());
+        REQUIRE(cb.front() == 3);
+        REQUIRE(cb.back() == 7);
+        REQUIRE(cb[1] == 4);
+
+        std::size_t segments = 0;
+        long        sum      = 0;
+        cb.for_each_segment([&](const long* first, const long* last) {
+            ++segments;
+            sum = std::accumulate(first, last, sum);
+        });
+        REQUIRE(segments == 2);
+        REQUIRE(sum == 3 + 4 + 5 + 6 + 7);
+
+        cb.flush(cb.begin() + 3, cb.end());
+        cb.flush();
+    }
+
+    SECTION("reopen")
+    {
+        jm::mapped_circular_buffer<long> cb(path, 5);
+        const long expected[] = {3, 4, 5, 6, 7};
+        REQUIRE(std::equal(cb.begin(), cb.end(), expected));
+
+        cb.pop_front();
+        cb.pop_back();
+        cb.push_back(10);
+        REQUIRE(cb.size() == 4);
+    }
+
+    SECTION("torn header")
+    {
+        // the states a crash can leave behind within pop_front, and so within an
+        // overwriting push_back, written into the header directly
+        auto write_header = [path](std::uint64_t head, std::uint64_t size) {
+            std::FILE* file = std::fopen(path, "r+b");
+            REQUIRE(file != nullptr);
+            std::fseek(file, offsetof(jm::detail::cb_mapped_header, head), SEEK_SET);
+            std::fwrite(&head, sizeof(head), 1, file);
+            std::fseek(file, offsetof(jm::detail::cb_mapped_header, size), SEEK_SET);
+            std::fwrite(&size, sizeof(size), 1, file);
+            std::fclose(file);
+        };
+
+        // the size was shrunk but the head not moved yet
+        write_header(3, 4);
+        {
+            jm::mapped_circular_buffer<long> cb(path, 5);
+            const long expected[] = {3, 4, 5, 6};
+            REQUIRE(cb.size() == 4);
+            REQUIRE(std::equal(cb.begin(), cb.end(), expected));
+        }
+
+        // the head was moved, the freed slot may be half overwritten
+        write_header(4, 4);
+        {
+            jm::mapped_circular_buffer<long> cb(path, 5);
+            const long expected[] = {4, 5, 6, 7};
+            REQUIRE(std::equal(cb.begin(), cb.end(), expected));
+
+            cb.push_back(8);
+            cb.push_back(9);
+            const long after[] = {5, 6, 7, 8, 9};
+            REQUIRE(std::equal(cb.begin(), cb.end(), after));
+        }
+    }
+
+    SECTION("mismatch")
+    {
+        REQUIRE_THROWS_AS(jm::mapped_circular_buffer<long>(path, 6), std::runtime_error);
+        REQUIRE_THROWS_AS(jm::mapped_circular_buffer<int>(path, 10), std::runtime_error);
+    }
+
+    std::remove(path);
+}
+
+TEST_CASE("shared_spsc_circular_buffer")
+{
+#if defined(__linux__)
+    typedef jm::shared_spsc_circular_buffer<int, jm::futex_wait> ring_t;
+#else
+    typedef jm::shared_spsc_circular_buffer<int, jm::yield_wait> ring_t;
+#endif
+
+    SECTION("single process")
+    {
+        std::vector<char> memory(ring_t::required_size(5) + JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE);
+        void*       aligned = memory.data();
+        std::size_t space   = memory.size();
+        std::align(JM_CIRCULAR_BUFFER_CACHE_LINE_SIZE, ring_t::required_size(5), aligned, space);
+
+        REQUIRE_THROWS_AS(ring_t::attach(aligned, space), std::runtime_error);
+        REQUIRE_THROWS_AS(ring_t::create(aligned, 0), std::invalid_argument);
+        REQUIRE_THROWS_AS(ring_t::create(aligned, ring_t::max_capacity + 1),
+                          std::invalid_argument);
+        ring_t producer = ring_t::create(aligned, 5);
+        ring_t consumer = ring_t::attach(aligned, space);
+        REQUIRE(consumer.max_size() == 5);
+
+        const int src[] = {1, 2, 3, 4, 5, 6, 7};
+        int       dest[7];
+        for(int lap = 0; lap < 4; ++lap) {
+            REQUIRE(producer.try_push(src, 3) == 3);
+            REQUIRE(producer.try_push(src + 3, 4) == 2);
+            REQUIRE(producer.full());
+            REQUIRE_FALSE(producer.try_push(8));
+
+            REQUIRE(consumer.try_pop(dest, 7) == 5);
+            REQUIRE(std::equal(dest, dest + 5, src));
+            REQUIRE(consumer.empty());
+            REQUIRE_FALSE(consumer.try_pop(dest[0]));
+        }
+
+        REQUIRE_THROWS_AS(jm::shared_spsc_circular_buffer<long>::attach(aligned, space),
+                          std::runtime_error);
+    }
+
+    SECTION("between processes")
+    {
+        const char* name = "/jm_circular_buffer_test";
+        jm::shared_memory::unlink(name);
+        jm::shared_memory memory(name, ring_t::required_size(64));
+        ring_t            consumer = ring_t::create(memory.data(), 64);
+
+        const int count = 100000;
+        const pid_t pid = ::fork();
+        REQUIRE(pid != -1);
+        if(pid == 0) {
+            jm::shared_memory mapped(name, 0);
+            ring_t           producer = ring_t::attach(mapped.data(), mapped.size());
+            for(int i = 0; i < count; ++i)
+                producer.push(i);
+            ::_exit(0);
+        }
+
+        bool in_order = true;
+        for(int i = 0; i < count; ++i) {
+            int value;
+            consumer.pop(value);
+            in_order = in_order && value == i;
+        }
+
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        jm::shared_memory::unlink(name);
+        REQUIRE(in_order);
+        REQUIRE(status == 0);
+        REQUIRE(consumer.empty());
+    }
+}
+
+TEST_CASE("mirrored_circular_buffer")
+{
+    jm::mirrored_circular_buffer<char> cb(100);
+    REQUIRE(cb.capacity() >= 100);
+    REQUIRE(cb.capacity() % jm::detail::cb_mirrored_mapping::granularity() == 0);
+    REQUIRE(cb.empty());
+
+    // move the head close to the end so that the contents wrap
+    const std::size_t capacity = cb.capacity();
+    std::vector<char> filler(capacity - 3, 'x');
+    REQUIRE(cb.try_push(filler.data(), filler.size()) == filler.size());
+    cb.pop_front(filler.size());
+    REQUIRE(cb.empty());
+
+    const char frame[] = "0123456789";
+    REQUIRE(cb.try_push(frame, 10) == 10);
+    REQUIRE(std::string(cb.data(), cb.size()) == "0123456789");
+    REQUIRE(std::string(cb.begin(), cb.end()) == "0123456789");
+    REQUIRE(cb.front() == '0');
+    REQUIRE(cb.back() == '9');
+
+    // both views of a slot are the same memory, '3' was written through the second
+    // and is read through the first once the head wrapped
+    cb.pop_front(2);
+    cb[1] = 'a';
+    cb.pop_front(1);
+    REQUIRE(cb.data() == &cb.front());
+    REQUIRE(cb.front() == 'a');
+
+    // the free space is contiguous as well
+    REQUIRE(cb.available() == capacity - 7);
+    std::memset(cb.write_data(), 'y', cb.available());
+    cb.commit(cb.available());
+    REQUIRE(cb.full());
+    REQUIRE_FALSE(cb.try_push('z'));
+    REQUIRE(cb[6] == '9');
+    REQUIRE(cb[7] == 'y');
+    REQUIRE(cb.back() == 'y');
+
+    cb.pop_back(capacity - 7);
+    REQUIRE(std::string(cb.begin(), cb.end()) == "a456789");
+    cb.clear();
+    REQUIRE(cb.empty());
+}
+
+#endif // defined(JM_CB_TEST_POSIX)
+
+namespace {
+
+    // counts its instances and throws from the assignment once assignments_left runs out
+    struct throwing_assignment {
+        static int instances;
+        static int assignments_left;
+
+        int value;
+
+        throwing_assignment(int v = 0) : value(v) { ++instances; }
+        throwing_assignment(const throwing_assignment& other) : value(other.value)
+        {
+            ++instances;
+        }
+        ~throwing_assignment() { --instances; }
+
+        throwing_assignment& operator=(const throwing_assignment& other)
+        {
+            if(assignments_left-- == 0)
+                throw std::runtime_error("assignment failed");
+            value = other.value;
+            return *this;
+        }
+    };
+
+    int throwing_assignment::instances        = 0;
+    int throwing_assignment::assignments_left = 0;
+
+} // namespace
+
+TEST_CASE("spsc_circular_buffer")
+{
+    SECTION("single threaded")
+    {
+        jm::spsc_circular_buffer<int, 5> cb;
+        REQUIRE(cb.empty());
+        REQUIRE(cb.max_size() == 5);
+
+        for(int i = 0; i < 5; ++i)
+            REQUIRE(cb.try_push(i));
+        REQUIRE(cb.full());
+        REQUIRE(!cb.try_push(5));
+
+        int value = -1;
+        for(int round = 0; round < 32; ++round) {
+            REQUIRE(cb.try_pop(value));
+            REQUIRE(value == round);
+            REQUIRE(cb.try_push(round + 5));
+            REQUIRE(cb.full());
+        }
+    }
+
+    SECTION("bulk")
+    {
+        jm::spsc_circular_buffer<int, 8> cb;
+        REQUIRE(cb.try_push(inc_vec.data(), 5) == 5);
+
+        int out[8] = {};
+        REQUIRE(cb.try_pop(out, 3) == 3);
+        REQUIRE(out[2] == 2);
+
+        // wraps around the end of the storage
+        REQUIRE(cb.try_push(inc_vec.data() + 5, 10) == 6);
+        REQUIRE(cb.full());
+        REQUIRE(cb.try_pop(out, 8) == 8);
+        for(int i = 0; i < 8; ++i)
+            REQUIRE(out[i] == i + 3);
+        REQUIRE(cb.try_pop(out, 8) == 0);
+    }
+
+    SECTION("reserve and peek")
+    {
+        jm::spsc_circular_buffer<std::string, 8> cb;
+        REQUIRE(cb.peek(4).empty());
+
+        // constructed in place, nothing is visible before the commit
+        jm::ring_segments<std::string> slots = cb.reserve(6);
+        REQUIRE(slots.size() == 6);
+        REQUIRE(slots.two.second == 0);
+        for(std::size_t i = 0; i < 4; ++i)
+            new(slots[i]) std::string(1, static_cast<char>('a' + i));
+        REQUIRE(cb.empty());
+        cb.commit(4);
+        REQUIRE(cb.size() == 4);
+
+        jm::ring_segments<std::string> items = cb.peek(3);
+        REQUIRE(items.size() == 3);
+        REQUIRE(*items[2] == "c");
+        cb.release(3);
+        REQUIRE(cb.size() == 1);
+
+        // the free slots wrap around the end of the storage
+        slots = cb.reserve(100);
+        REQUIRE(slots.size() == 7);
+        REQUIRE(slots.one.second == 4);
+        REQUIRE(slots.two.second == 3);
+        for(std::size_t i = 0; i < slots.size(); ++i)
+            new(slots[i]) std::string(20, static_cast<char>('e' + i));
+        cb.commit(slots.size());
+        REQUIRE(cb.full());
+        REQUIRE(cb.reserve(1).empty());
+
+        items = cb.peek(8);
+        REQUIRE(items.size() == 8);
+        REQUIRE(*items.one.first == "d");
+        REQUIRE(items.two.first[2] == std::string(20, 'k'));
+        cb.release(2);
+
+        std::string out;
+        REQUIRE(cb.try_pop(out));
+        REQUIRE(out == std::string(20, 'f'));
+    }
+
+    SECTION("non trivial types")
+    {
+        const auto constructions = num_constructions;
+        const auto deletions     = num_deletions;
+        {
+            jm::spsc_circular_buffer<leak_checker, 4> cb;
+            std::vector<leak_checker>                 v(3);
+            REQUIRE(cb.try_push(v.data(), 3) == 3);
+            REQUIRE(cb.try_emplace());
+            REQUIRE(!cb.try_emplace());
+
+            leak_checker out;
+            REQUIRE(cb.try_pop(out));
+            REQUIRE(cb.try_pop(v.data(), 2) == 2);
+        }
+        REQUIRE(num_constructions - constructions == num_deletions - deletions);
+    }
+
+    SECTION("throwing assignment")
+    {
+        {
+            jm::spsc_circular_buffer<throwing_assignment, 4> cb;
+            throwing_assignment                              out[4];
+            for(int i = 0; i < 3; ++i)
+                REQUIRE(cb.try_emplace(i));
+            throwing_assignment::assignments_left = 1;
+            REQUIRE(cb.try_pop(out[0]));
+
+            // wraps around, the second segment throws after the first was assigned
+            REQUIRE(cb.try_emplace(3));
+            REQUIRE(cb.try_emplace(4));
+            throwing_assignment::assignments_left = 3;
+            REQUIRE_THROWS_AS(cb.try_pop(out, 4), std::runtime_error);
+            REQUIRE(cb.size() == 4);
+
+            throwing_assignment::assignments_left = 4;
+            REQUIRE(cb.try_pop(out, 4) == 4);
+            REQUIRE(out[0].value == 1);
+            REQUIRE(out[3].value == 4);
+            REQUIRE(cb.empty());
+
+            REQUIRE(cb.try_emplace(5));
+            throwing_assignment::assignments_left = 100;
+        }
+        REQUIRE(throwing_assignment::instances == 0);
+    }
+
+    SECTION("two threads")
+    {
+        constexpr int count = 100000;
+        auto          cb    = make_aligned<jm::spsc_circular_buffer<int, 64>>();
+
+        std::thread producer([&] {
+            for(int i = 0; i < count;)
+                if(i % 3 == 0) {
+                    int batch[7];
+                    std::iota(batch, batch + 7, i);
+                    i += static_cast<int>(cb->try_push(batch, std::min(7, count - i)));
+                }
+                else if(cb->try_push(i))
+                    ++i;
+        });
+
+        bool in_order = true;
+        for(int expected = 0; expected < count;) {
+            int batch[5];
+            for(std::size_t n = cb->try_pop(batch, 5), i = 0; i < n; ++i)
+                in_order &= batch[i] == expected++;
+        }
+
+        producer.join();
+        REQUIRE(in_order);
+        REQUIRE(cb->empty());
+    }
+
+    SECTION("two threads in batches")
+    {
+        constexpr int count = 100000;
+        auto          cb    = make_aligned<jm::spsc_circular_buffer<int, 64>>();
+
+        std::thread producer([&] {
+            for(int i = 0; i < count;) {
+                const jm::ring_segments<int> slots =
+                    cb->reserve(static_cast<std::size_t>(std::min(13, count - i)));
+                for(std::size_t n = 0; n < slots.size(); ++n)
+                    *slots[n] = i++;
+                cb->commit(slots.size());
+            }
+        });
+
+        bool in_order = true;
+        for(int expected = 0; expected < count;) {
+            const jm::ring_segments<int> items = cb->peek(9);
+            for(std::size_t n = 0; n < items.size(); ++n)
+                in_order &= *items[n] == expected++;
+            cb->release(items.size());
+        }
+
+        producer.join();
+        REQUIRE(in_order);
+        REQUIRE(cb->empty());
+    }
+}
+
+TEST_CASE("mpmc_circular_buffer")
+{
+    SECTION("single threaded")
+    {
+        jm::mpmc_circular_buffer<int, 5> cb;
+        REQUIRE(cb.empty());
+        REQUIRE(cb.max_size() == 5);
+
+        for(int i = 0; i < 5; ++i)
+            REQUIRE(cb.try_push(i));
+        REQUIRE(cb.full());
+        REQUIRE(!cb.try_push(5));
+
+        int value = -1;
+        for(int round = 0; round < 32; ++round) {
+            REQUIRE(cb.try_pop(value));
+            REQUIRE(value == round);
+            cb.push(round + 5);
+            REQUIRE(cb.size() == 5);
+        }
+
+        for(int i = 0; i < 5; ++i)
+            cb.pop(value);
+        REQUIRE(value == 36);
+        REQUIRE(!cb.try_pop(value));
+    }
+
+    SECTION("non trivial types")
+    {
+        const auto constructions = num_constructions;
+        const auto deletions     = num_deletions;
+        {
+            jm::mpmc_circular_buffer<std::unique_ptr<leak_checker>, 4> cb;
+            for(int i = 0; i < 3; ++i)
+                REQUIRE(cb.try_emplace(new leak_checker()));
+
+            std::unique_ptr<leak_checker> out;
+            REQUIRE(cb.try_pop(out));
+            REQUIRE(out != nullptr);
+        }
+        REQUIRE(num_constructions - constructions == num_deletions - deletions);
+    }
+
+    SECTION("reserve and peek")
+    {
+        jm::mpmc_circular_buffer<int, 6> cb;
+        auto                             slots = cb.reserve(4);
+        REQUIRE(slots.size() == 4);
+        for(std::size_t i = 0; i < slots.size(); ++i)
+            *slots[i] = static_cast<int>(i);
+
+        // claimed but not yet published
+        int value = -1;
+        REQUIRE(!cb.try_pop(value));
+        cb.commit(slots);
+
+        auto items = cb.peek(3);
+        REQUIRE(items.size() == 3);
+        REQUIRE(*items[2] == 2);
+        cb.release(items);
+
+        // takes the remaining free slots around the end of the storage
+        slots = cb.reserve(10);
+        REQUIRE(slots.size() == 5);
+        REQUIRE(slots.one.second == 2);
+        REQUIRE(slots.two.second == 3);
+        for(std::size_t i = 0; i < slots.size(); ++i)
+            *slots[i] = static_cast<int>(10 + i);
+        cb.commit(slots);
+        REQUIRE(cb.full());
+        REQUIRE(cb.reserve(1).empty());
+
+        REQUIRE(cb.try_pop(value));
+        REQUIRE(value == 3);
+        items = cb.peek(10);
+        REQUIRE(items.size() == 5);
+        REQUIRE(*items[4] == 14);
+        cb.release(items);
+        REQUIRE(cb.empty());
+    }
+
+    SECTION("batches from many threads")
+    {
+        constexpr int producers = 3, consumers = 3, per_producer = 20000;
+        auto          cb = make_aligned<jm::mpmc_circular_buffer<int, 64>>();
+
+        std::atomic<long long>   sum{ 0 };
+        std::atomic<int>         popped{ 0 };
+        std::vector<std::thread> threads;
+        for(int p = 0; p < producers; ++p)
+            threads.emplace_back([&cb, p] {
+                for(int i = 0; i < per_producer;) {
+                    const auto slots = cb->reserve(static_cast<std::size_t>(
+                        std::min(1 + i % 7, per_producer - i)));
+                    for(std::size_t n = 0; n < slots.size(); ++n)
+                        *slots[n] = p * per_producer + i++;
+                    cb->commit(slots);
+                }
+            });
+
+        for(int c = 0; c < consumers; ++c)
+            threads.emplace_back([&] {
+                while(popped.load() < producers * per_producer) {
+                    const auto items = cb->peek(5);
+                    long long  local = 0;
+                    for(std::size_t n = 0; n < items.size(); ++n)
+                        local += *items[n];
+                    cb->release(items);
+
+                    sum += local;
+                    popped += static_cast<int>(items.size());
+                }
+            });
+
+        for(auto& thread : threads)
+            thread.join();
+
+        const long long total = producers * per_producer;
+        REQUIRE(sum == total * (total - 1) / 2);
+        REQUIRE(cb->empty());
+    }
+
+    auto run_threads = [](auto& cb) {
+        constexpr int producers = 4, consumers = 2, per_producer = 2000;
+
+        std::atomic<long long> sum{ 0 };
+        std::atomic<int>       popped{ 0 };
+        std::vector<std::thread> threads;
+        for(int p = 0; p < producers; ++p)
+            threads.emplace_back([&cb, p] {
+                for(int i = 0; i < per_producer; ++i) {
+                    const int value = p * per_producer + i;
+                    if(i % 2 == 0)
+                        cb.push(value);
+                    else
+                        while(!cb.try_push(value))
+                            std::this_thread::yield();
+                }
+            });
+
+        for(int c = 0; c < consumers; ++c)
+            threads.emplace_back([&] {
+                int value;
+                while(popped.fetch_add(1) < producers * per_producer) {
+                    cb.pop(value);
+                    sum += value;
+                }
+            });
+
+        for(auto& thread : threads)
+            thread.join();
+
+        const long long total = producers * per_producer;
+        REQUIRE(sum == total * (total - 1) / 2);
+        REQUIRE(cb.empty());
+    };
+
+    SECTION("many threads spinning")
+    {
+        auto cb = make_aligned<jm::mpmc_circular_buffer<int, 64>>();
+        run_threads(*cb);
+    }
+
+    SECTION("many threads yielding")
+    {
+        auto cb = make_aligned<jm::mpmc_circular_buffer<int, 48, jm::yield_wait>>();
+        run_threads(*cb);
+    }
+
+    SECTION("many threads waiting")
+    {
+        auto cb = make_aligned<jm::mpmc_circular_buffer<int, 16, jm::atomic_wait>>();
+        run_threads(*cb);
+    }
+}